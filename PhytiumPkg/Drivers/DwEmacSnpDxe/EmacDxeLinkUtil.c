@@ -0,0 +1,211 @@
+/** @file
+
+  Copyright (c) 2011 - 2019, Intel Corporaton. All rights reserved.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  GMAC programming that follows the resolved link, called from the PHY layer.
+
+**/
+
+
+#include "EmacDxeLinkUtil.h"
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/IoLib.h>
+
+STATIC CONST UINT16  mEmacMmcCounterOffset[EmacMmcCounterMax] = {
+  DW_EMAC_GMACGRP_TXOCTETCOUNT_GB_OFST,
+  DW_EMAC_GMACGRP_TXFRAMECOUNT_GB_OFST,
+  DW_EMAC_GMACGRP_TXFRAMECOUNT_G_OFST,
+  DW_EMAC_GMACGRP_TXUNICASTFRAMES_GB_OFST,
+  DW_EMAC_GMACGRP_TXMULTICASTFRAMES_GB_OFST,
+  DW_EMAC_GMACGRP_TXBROADCASTFRAMES_GB_OFST,
+  DW_EMAC_GMACGRP_TXUNDERFLOWERROR_OFST,
+  DW_EMAC_GMACGRP_TXSINGLECOL_G_OFST,
+  DW_EMAC_GMACGRP_TXMULTICOL_G_OFST,
+  DW_EMAC_GMACGRP_TXLATECOL_OFST,
+  DW_EMAC_GMACGRP_TXEXESSCOL_OFST,
+  DW_EMAC_GMACGRP_RXFRAMECOUNT_GB_OFST,
+  DW_EMAC_GMACGRP_RXOCTETCOUNT_GB_OFST,
+  DW_EMAC_GMACGRP_RXBROADCASTFRAMES_G_OFST,
+  DW_EMAC_GMACGRP_RXMULTICASTFRAMES_G_OFST,
+  DW_EMAC_GMACGRP_RXUNICASTFRAMES_G_OFST,
+  DW_EMAC_GMACGRP_RXCRCERROR_OFST,
+  DW_EMAC_GMACGRP_RXRUNTERROR_OFST,
+  DW_EMAC_GMACGRP_RXJABBERERROR_OFST,
+  DW_EMAC_GMACGRP_RXUNDERSIZE_G_OFST,
+  DW_EMAC_GMACGRP_RXOVERSIZE_G_OFST,
+  DW_EMAC_GMACGRP_RXFIFOOVERFLOW_OFST
+};
+
+/**
+	Program the GMAC flow control for the PAUSE resolved on the link.
+
+	@param PauseTx				PAUSE frames are sent
+	@param PauseRx				PAUSE frames are honored
+	@param MacBaseAddress 		GMAC register base address
+**/
+VOID
+EFIAPI
+EmacConfigFlowControl (
+  IN  BOOLEAN      PauseTx,
+  IN  BOOLEAN      PauseRx,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  UINT32    FlowControl;
+  UINT32    OpMode;
+
+  FlowControl = 0;
+  if (PauseTx) {
+    FlowControl |= (DW_EMAC_PAUSE_TIME << DW_EMAC_GMACGRP_FLOW_CONTROL_PT_SHIFT) | DW_EMAC_GMACGRP_FLOW_CONTROL_TFE;
+  }
+  if (PauseRx) {
+    FlowControl |= DW_EMAC_GMACGRP_FLOW_CONTROL_RFE;
+  }
+  MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_FLOW_CONTROL_OFST, FlowControl);
+
+  // PAUSE frames are sent when the RX FIFO fills past the activation threshold
+  OpMode = MmioRead32 (MacBaseAddress + DW_EMAC_DMAGRP_OPERATION_MODE_OFST);
+  OpMode &= ~(DW_EMAC_DMAGRP_OPERATION_MODE_EFC | DW_EMAC_DMAGRP_OPERATION_MODE_RFA_MASK |
+              DW_EMAC_DMAGRP_OPERATION_MODE_RFD_MASK);
+  if (PauseTx) {
+    OpMode |= DW_EMAC_DMAGRP_OPERATION_MODE_EFC | DW_EMAC_DMAGRP_OPERATION_MODE_RFD_2K;
+  }
+  MmioWrite32 (MacBaseAddress + DW_EMAC_DMAGRP_OPERATION_MODE_OFST, OpMode);
+}
+
+/**
+	Enable or disable LPI entry of the GMAC transmitter.
+
+	@param Enable				Enter LPI when the transmitter is idle
+	@param LinkStatusTimerMs	Delay before LPI entry once the link is up
+	@param WakeUs				Wait after leaving LPI before transmitting
+	@param MacBaseAddress 		GMAC register base address
+**/
+VOID
+EFIAPI
+EmacConfigLpi (
+  IN  BOOLEAN      Enable,
+  IN  UINT32       LinkStatusTimerMs,
+  IN  UINT32       WakeUs,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  UINT32    Control;
+
+  Control = MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_OFST);
+  if (Enable) {
+    MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_OFST,
+                 ((LinkStatusTimerMs & DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_LST_MASK) << DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_LST_SHIFT) |
+                 (WakeUs & DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_TWT_MASK));
+    Control |= DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_LPIEN | DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_PLSEN |
+               DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_PLS;
+  } else {
+    Control &= ~(DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_LPIEN | DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_PLSEN |
+                 DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_PLS);
+  }
+  MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_OFST, Control);
+}
+
+/**
+	Fold the GMAC MMC counters into 64-bit totals. The difference of two raw
+	values is right across one wrap, so sample more often than the fastest
+	counter wraps.
+
+	@param Counters				Totals and last raw values of the GMAC
+	@param MacBaseAddress 		GMAC register base address
+**/
+VOID
+EFIAPI
+EmacMmcSample (
+  IN OUT EMAC_MMC_COUNTERS  *Counters,
+  IN     UINTN              MacBaseAddress
+  )
+{
+  UINT32    Data32;
+  UINTN     Index;
+
+  for (Index = 0; Index < EmacMmcCounterMax; Index++) {
+    Data32 = MmioRead32 (MacBaseAddress + mEmacMmcCounterOffset[Index]);
+    Counters->Total[Index] += (UINT32)(Data32 - Counters->Last[Index]);
+    Counters->Last[Index] = Data32;
+  }
+}
+
+/**
+	Fill the SNP statistics backed by the GMAC MMC counters. Fields without a
+	counter are left untouched.
+
+	@param Counters				Totals of the GMAC, from EmacMmcSample
+	@param Statistics			SNP statistics to fill
+**/
+VOID
+EFIAPI
+EmacMmcGetStatistics (
+  IN  CONST EMAC_MMC_COUNTERS  *Counters,
+  OUT EFI_NETWORK_STATISTICS   *Statistics
+  )
+{
+  CONST UINT64    *Mmc;
+
+  Mmc = Counters->Total;
+  Statistics->RxTotalFrames     = Mmc[EmacMmcRxFramesGb];
+  Statistics->RxUnicastFrames   = Mmc[EmacMmcRxUnicastG];
+  Statistics->RxBroadcastFrames = Mmc[EmacMmcRxBroadcastG];
+  Statistics->RxMulticastFrames = Mmc[EmacMmcRxMulticastG];
+  Statistics->RxGoodFrames      = Mmc[EmacMmcRxUnicastG] + Mmc[EmacMmcRxBroadcastG] + Mmc[EmacMmcRxMulticastG];
+  Statistics->RxUndersizeFrames = Mmc[EmacMmcRxRuntError] + Mmc[EmacMmcRxUndersizeG];
+  Statistics->RxOversizeFrames  = Mmc[EmacMmcRxOversizeG] + Mmc[EmacMmcRxJabberError];
+  Statistics->RxDroppedFrames   = Mmc[EmacMmcRxFifoOverflow];
+  Statistics->RxCrcErrorFrames  = Mmc[EmacMmcRxCrcError];
+  Statistics->RxTotalBytes      = Mmc[EmacMmcRxOctetsGb];
+  Statistics->TxTotalFrames     = Mmc[EmacMmcTxFramesGb];
+  Statistics->TxGoodFrames      = Mmc[EmacMmcTxFramesG];
+  Statistics->TxUnicastFrames   = Mmc[EmacMmcTxUnicastGb];
+  Statistics->TxBroadcastFrames = Mmc[EmacMmcTxBroadcastGb];
+  Statistics->TxMulticastFrames = Mmc[EmacMmcTxMulticastGb];
+  Statistics->TxDroppedFrames   = Mmc[EmacMmcTxUnderflow];
+  Statistics->TxTotalBytes      = Mmc[EmacMmcTxOctetsGb];
+  Statistics->TxErrorFrames     = Mmc[EmacMmcTxFramesGb] - MIN (Mmc[EmacMmcTxFramesG], Mmc[EmacMmcTxFramesGb]);
+  Statistics->TxRetryFrames     = Mmc[EmacMmcTxSingleCol] + Mmc[EmacMmcTxMultiCol];
+  Statistics->Collisions        = Mmc[EmacMmcTxSingleCol] + Mmc[EmacMmcTxMultiCol] +
+                                  Mmc[EmacMmcTxLateCol] + Mmc[EmacMmcTxExcessCol];
+}
+
+/**
+	Clear the 64-bit totals, the next sample counts from the last raw values.
+
+	@param Counters				Totals of the GMAC
+**/
+VOID
+EFIAPI
+EmacMmcClear (
+  IN OUT EMAC_MMC_COUNTERS  *Counters
+  )
+{
+  ZeroMem (Counters->Total, sizeof (Counters->Total));
+}
+
+/**
+	Reload the last raw values from the GMAC after a reset of the GMAC cleared
+	the MMC counters, the next sample counts from the cleared counters and
+	the totals are kept. Traffic since the last sample is lost.
+
+	@param Counters				Totals and last raw values of the GMAC
+	@param MacBaseAddress 		GMAC register base address
+**/
+VOID
+EFIAPI
+EmacMmcRebase (
+  IN OUT EMAC_MMC_COUNTERS  *Counters,
+  IN     UINTN              MacBaseAddress
+  )
+{
+  UINTN     Index;
+
+  for (Index = 0; Index < EmacMmcCounterMax; Index++) {
+    Counters->Last[Index] = MmioRead32 (MacBaseAddress + mEmacMmcCounterOffset[Index]);
+  }
+}
@@ -0,0 +1,151 @@
+/** @file
+
+  Copyright (c) 2011 - 2019, Intel Corporaton. All rights reserved.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  GMAC programming that follows the resolved link, called from the PHY layer.
+
+**/
+
+
+#ifndef _EMAC_DXE_LINK_UTIL_H__
+#define _EMAC_DXE_LINK_UTIL_H__
+
+#include <Protocol/SimpleNetwork.h>
+
+#include "EmacDxeUtil.h"
+
+// GMAC flow control
+#ifndef DW_EMAC_GMACGRP_FLOW_CONTROL_OFST
+#define DW_EMAC_GMACGRP_FLOW_CONTROL_OFST             0x0018
+#endif
+#define DW_EMAC_GMACGRP_FLOW_CONTROL_TFE              BIT1            // Transmit PAUSE frames
+#define DW_EMAC_GMACGRP_FLOW_CONTROL_RFE              BIT2            // Honor received PAUSE frames
+#define DW_EMAC_GMACGRP_FLOW_CONTROL_PT_SHIFT         16
+#define DW_EMAC_PAUSE_TIME                            0xFFFF          // Pause quanta sent in a PAUSE frame
+#ifndef DW_EMAC_DMAGRP_OPERATION_MODE_OFST
+#define DW_EMAC_DMAGRP_OPERATION_MODE_OFST            0x1018
+#endif
+#define DW_EMAC_DMAGRP_OPERATION_MODE_EFC             BIT8            // RX FIFO thresholds trigger PAUSE frames
+#define DW_EMAC_DMAGRP_OPERATION_MODE_RFA_MASK        (3 << 9)        // Activate at FIFO full - (1 + RFA) KB
+#define DW_EMAC_DMAGRP_OPERATION_MODE_RFD_MASK        (3 << 11)       // Deactivate at FIFO full - (1 + RFD) KB
+#define DW_EMAC_DMAGRP_OPERATION_MODE_RFD_2K          (1 << 11)
+
+// GMAC LPI control
+#ifndef DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_OFST
+#define DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_OFST       0x0030
+#endif
+#ifndef DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_OFST
+#define DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_OFST       0x0034
+#endif
+#define DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_LPIEN      BIT16           // Transmit LPI enable
+#define DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_PLS        BIT17           // PHY link status
+#define DW_EMAC_GMACGRP_LPI_CONTROL_STATUS_PLSEN      BIT18           // PHY link status enable
+#define DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_LST_SHIFT  16              // Link status timer, ms
+#define DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_LST_MASK   0x3FF
+#define DW_EMAC_GMACGRP_LPI_TIMERS_CONTROL_TWT_MASK   0xFFFF          // Transmit wait timer, us
+
+// GMAC MMC counters, free running and not cleared on read
+#define DW_EMAC_GMACGRP_TXOCTETCOUNT_GB_OFST          0x0114
+#define DW_EMAC_GMACGRP_TXFRAMECOUNT_GB_OFST          0x0118
+#define DW_EMAC_GMACGRP_TXUNICASTFRAMES_GB_OFST       0x013C
+#define DW_EMAC_GMACGRP_TXMULTICASTFRAMES_GB_OFST     0x0140
+#define DW_EMAC_GMACGRP_TXBROADCASTFRAMES_GB_OFST     0x0144
+#define DW_EMAC_GMACGRP_TXUNDERFLOWERROR_OFST         0x0148
+#define DW_EMAC_GMACGRP_TXSINGLECOL_G_OFST            0x014C
+#define DW_EMAC_GMACGRP_TXMULTICOL_G_OFST             0x0150
+#define DW_EMAC_GMACGRP_TXLATECOL_OFST                0x0158
+#define DW_EMAC_GMACGRP_TXEXESSCOL_OFST               0x015C
+#define DW_EMAC_GMACGRP_TXFRAMECOUNT_G_OFST           0x0168
+#define DW_EMAC_GMACGRP_RXFRAMECOUNT_GB_OFST          0x0180
+#define DW_EMAC_GMACGRP_RXOCTETCOUNT_GB_OFST          0x0184
+#define DW_EMAC_GMACGRP_RXBROADCASTFRAMES_G_OFST      0x018C
+#define DW_EMAC_GMACGRP_RXMULTICASTFRAMES_G_OFST      0x0190
+#define DW_EMAC_GMACGRP_RXCRCERROR_OFST               0x0194
+#define DW_EMAC_GMACGRP_RXRUNTERROR_OFST              0x019C
+#define DW_EMAC_GMACGRP_RXJABBERERROR_OFST            0x01A0
+#define DW_EMAC_GMACGRP_RXUNDERSIZE_G_OFST            0x01A4
+#define DW_EMAC_GMACGRP_RXOVERSIZE_G_OFST             0x01A8
+#define DW_EMAC_GMACGRP_RXUNICASTFRAMES_G_OFST        0x01C4
+#define DW_EMAC_GMACGRP_RXFIFOOVERFLOW_OFST           0x01D4
+
+//
+// GMAC MMC counters folded by EmacMmcSample
+//
+typedef enum {
+  EmacMmcTxOctetsGb,
+  EmacMmcTxFramesGb,
+  EmacMmcTxFramesG,
+  EmacMmcTxUnicastGb,
+  EmacMmcTxMulticastGb,
+  EmacMmcTxBroadcastGb,
+  EmacMmcTxUnderflow,
+  EmacMmcTxSingleCol,
+  EmacMmcTxMultiCol,
+  EmacMmcTxLateCol,
+  EmacMmcTxExcessCol,
+  EmacMmcRxFramesGb,
+  EmacMmcRxOctetsGb,
+  EmacMmcRxBroadcastG,
+  EmacMmcRxMulticastG,
+  EmacMmcRxUnicastG,
+  EmacMmcRxCrcError,
+  EmacMmcRxRuntError,
+  EmacMmcRxJabberError,
+  EmacMmcRxUndersizeG,
+  EmacMmcRxOversizeG,
+  EmacMmcRxFifoOverflow,
+  EmacMmcCounterMax
+} EMAC_MMC_COUNTER;
+
+typedef struct {
+  UINT64   Total[EmacMmcCounterMax];      // 64-bit totals since the last clear
+  UINT32   Last[EmacMmcCounterMax];       // Last raw value of the free running counters
+} EMAC_MMC_COUNTERS;
+
+VOID
+EFIAPI
+EmacConfigFlowControl (
+  IN  BOOLEAN      PauseTx,
+  IN  BOOLEAN      PauseRx,
+  IN  UINTN        MacBaseAddress
+  );
+
+VOID
+EFIAPI
+EmacConfigLpi (
+  IN  BOOLEAN      Enable,
+  IN  UINT32       LinkStatusTimerMs,
+  IN  UINT32       WakeUs,
+  IN  UINTN        MacBaseAddress
+  );
+
+VOID
+EFIAPI
+EmacMmcSample (
+  IN OUT EMAC_MMC_COUNTERS  *Counters,
+  IN     UINTN              MacBaseAddress
+  );
+
+VOID
+EFIAPI
+EmacMmcGetStatistics (
+  IN  CONST EMAC_MMC_COUNTERS  *Counters,
+  OUT EFI_NETWORK_STATISTICS   *Statistics
+  );
+
+VOID
+EFIAPI
+EmacMmcClear (
+  IN OUT EMAC_MMC_COUNTERS  *Counters
+  );
+
+VOID
+EFIAPI
+EmacMmcRebase (
+  IN OUT EMAC_MMC_COUNTERS  *Counters,
+  IN     UINTN              MacBaseAddress
+  );
+
+#endif // _EMAC_DXE_LINK_UTIL_H__
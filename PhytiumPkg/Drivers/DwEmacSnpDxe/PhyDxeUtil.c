@@ -16,16 +16,212 @@
 
 #include "PhyDxeUtil.h"
 #include "EmacDxeUtil.h"
+#include "EmacDxeLinkUtil.h"
 
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/HobLib.h>
 #include <Library/IoLib.h>
+#include <Library/PerformanceLib.h>
+#include <Library/PrintLib.h>
 #include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+STATIC EFI_GUID  mPhyDxeVariableGuid = PHY_DXE_VARIABLE_GUID;
+STATIC EFI_GUID  mPhyAutoNegoHobGuid = PHY_AUTONEGO_HOB_GUID;
+
+// PHY instances of every GMAC port
+STATIC PHY_DRIVER  *mPhyInstances[PHY_INSTANCE_MAX];
+
+STATIC
+PHY_MDIO_BUS *
+PhyMdioGetBus (
+  IN UINTN    MacBaseAddress
+  );
+
+STATIC
+UINT32
+PhyMdioGetPortAddress (
+  IN UINTN    MacBaseAddress
+  );
+
+STATIC
+BOOLEAN
+PhyMdioIsShared (
+  IN PHY_MDIO_BUS   *Bus,
+  IN UINTN          MacBaseAddress
+  );
+
+STATIC
+VOID
+PhyMdioDetach (
+  IN UINTN    MacBaseAddress
+  );
+
+STATIC
+VOID
+PhyTrace (
+  IN UINT8    Event,
+  IN UINT32   PhyAddr,
+  IN UINT32   Reg,
+  IN UINT32   Value
+  );
+
+STATIC
+VOID
+PhyRegisterExitBoot (
+  VOID
+  );
+
+STATIC
+VOID
+PhyMdioScan (
+  IN PHY_MDIO_BUS   *Bus
+  );
+
+STATIC
+EFI_STATUS
+PhyRegisterInstance (
+  IN PHY_DRIVER   *PhyDriver
+  );
+
+STATIC
+EFI_STATUS
+PhyAdoptLinkBringUp (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+BOOLEAN
+PhyLinkIsPreserved (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+EFI_STATUS
+PhyLinkResume (
+  IN PHY_DRIVER       *PhyDriver,
+  IN PHY_LINK_STATE   State,
+  IN UINT64           PhaseStart,
+  IN UINTN            MacBaseAddress
+  );
+
+STATIC
+VOID
+PhyAdjustMac (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Speed,
+  IN UINT32       Duplex,
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+VOID
+PhyPreconfigureMac (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+BOOLEAN
+PhyCheckLinkQuality (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Speed,
+  IN BOOLEAN      CheckIdleErrors,
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+EFI_STATUS
+PhyReadGigStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *GigStatus,
+  IN  UINTN        MacBaseAddress
+  );
+
+STATIC
+VOID
+PhySampleCounters (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+EFI_STATUS
+PhySelectPage (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Page,
+  IN  UINTN        MacBaseAddress
+  );
+
+STATIC
+VOID
+PhyRestoreDefaultPage (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  );
+
+STATIC
+UINT8
+PhyLoadLinkMode (
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+CONST PHY_LINK_MODE_SETTING *
+PhyLinkModeSetting (
+  IN PHY_DRIVER   *PhyDriver
+  );
+
+STATIC
+BOOLEAN
+PhyLinkModeProgrammed (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Control,
+  IN UINT32       Advertise,
+  IN UINT32       GigControl
+  );
+
+STATIC
+EFI_STATUS
+PhyEeeAdvertise (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT BOOLEAN      *Changed,
+  IN  UINTN        MacBaseAddress
+  );
+
+STATIC
+BOOLEAN
+PhyEeeAdvertised (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  );
+
+STATIC
+VOID
+PhyEeeResolve (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Link,
+  IN UINT32       Speed,
+  IN UINT32       Duplex,
+  IN UINTN        MacBaseAddress
+  );
 
 /**
 	Phy initialization config.
-	1.detece phy devices
-	2.phy devices config
+	1.register the phy instance
+	2.detece phy devices, program the GMAC for the link of the previous boot
+	3.adopt auto-negotiation started before DXE, if a PHY_AUTONEGO_HOB describes it
+	4.keep a link already up with the expected config, with PHY_RESET_CHECK_LINK
+	5.otherwise start the link bring-up state machine, fall back to a blocking
+	  phy devices config if the timer event cannot be created
+	Bring-up runs from a timer event per instance, so the ports of a
+	multi-GMAC board reset and negotiate at the same time.
 
 	@param PhyDriver		A point to Phy dirver structureM
 	@param MacBaseAddress 	GMAC register base address
@@ -44,607 +240,2963 @@ PhyDxeInitialization (
 
   DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
 
+  Status = PhyRegisterInstance (PhyDriver);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   //
   // initialize the phyaddr
   //
-  PhyDriver->PhyAddr = 0;
+  PhyDriver->PhyAddr = PHY_ADDR_NONE;
   PhyDriver->PhyCurrentLink = LINK_DOWN;
   PhyDriver->PhyOldLink = LINK_DOWN;
-
+  PhyDriver->QueryLink = MAX_UINT32;
+  PhyDriver->MacBaseAddress = MacBaseAddress;
+  PhyDriver->LinkState = PhyLinkStateIdle;
+  PhyDriver->PollInterval = 0;
+  PhyDriver->IrqMode = PHY_LINK_IRQ_MODE;
+  PhyDriver->IrqPending = FALSE;
+  PhyDriver->MacConfigValid = FALSE;
+  PhyDriver->SavedLink = 0;
+  PhyDriver->LinkMode = PhyLoadLinkMode (MacBaseAddress);
+  PhyDriver->LinkPending = FALSE;
+  PhyDriver->ResolvedValid = FALSE;
+  PhyDriver->Retrains = 0;
+  PhyDriver->QualityExhausted = FALSE;
+  PhyDriver->QualityCheckTime = 0;
+  PhyDriver->QualityIdleErrors = 0;
+  ZeroMem (&PhyDriver->Counters, sizeof (PhyDriver->Counters));
+  ZeroMem (PhyDriver->RecentReadTime, sizeof (PhyDriver->RecentReadTime));
+  ZeroMem (&PhyDriver->MdioCounters, sizeof (PhyDriver->MdioCounters));
+  PhyShadowInvalidate (PhyDriver);
+  PhyRegisterExitBoot ();
+
+  PERF_START_EX (gImageHandle, PHY_PERF_DETECT, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
   Status = PhyDetectDevice (PhyDriver, MacBaseAddress);
+  PERF_END_EX (gImageHandle, PHY_PERF_DETECT, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
   if (EFI_ERROR (Status)) {
     return EFI_NOT_FOUND;
   }
 
-  PhyConfig (PhyDriver, MacBaseAddress);
+  if (PHY_LINK_PRECONFIG) {
+    PhyPreconfigureMac (PhyDriver, MacBaseAddress);
+  }
+
+  Status = PhyAdoptLinkBringUp (PhyDriver, MacBaseAddress);
+  if (!EFI_ERROR (Status)) {
+    return EFI_SUCCESS;
+  }
+
+  if ((PHY_RESET_MODE & PHY_RESET_CHECK_LINK) != 0 && PhyLinkIsPreserved (PhyDriver, MacBaseAddress)) {
+    Status = PhyLinkResume (PhyDriver, PhyLinkStateAdjustMac, 0, MacBaseAddress);
+    if (!EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "SNP:PHY: Keep the link established before this boot\r\n"));
+      return EFI_SUCCESS;
+    }
+  }
+
+  Status = PhyStartLinkBringUp (PhyDriver, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    PhyConfig (PhyDriver, MacBaseAddress);
+    PhyEnableLinkInterrupt (PhyDriver, MacBaseAddress);
+  }
 
   return EFI_SUCCESS;
 }
 
 
 /**
-	Detect phy devices.
-
-	@param PhyDriver		  A point to Phy dirver structureM
-	@param MacBaseAddress     GMAC register base address
+	Release the MDIO address claimed by a phy instance.
 
-	@retval EFI_SUCCESS			 The phy interface was detected.
-	@retval EFI_DEVICE_ERROR	 Fail to detect ethernet phy.
+	@param PhyDriver		A point to Phy dirver structure
 **/
-EFI_STATUS
-EFIAPI
-PhyDetectDevice (
-  IN PHY_DRIVER   *PhyDriver,
-  IN UINTN        MacBaseAddress
+STATIC
+VOID
+PhyReleaseAddress (
+  IN PHY_DRIVER   *PhyDriver
   )
 {
-  UINT32       PhyAddr;
-  EFI_STATUS   Status;
-
-  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
+  PHY_MDIO_BUS  *Bus;
 
-  for (PhyAddr = 0; PhyAddr < 32; PhyAddr++) {
-    Status = PhyReadId (PhyAddr, MacBaseAddress);
-    if (EFI_ERROR(Status)) {
-      continue;
-    }
-
-    PhyDriver->PhyAddr = PhyAddr;
-    return EFI_SUCCESS;
+  if (PhyDriver->PhyAddr >= PHY_MAX_ADDR) {
+    return;
   }
 
-  DEBUG ((DEBUG_INFO, "SNP:PHY: Fail to detect Ethernet PHY!\r\n"));
-  return EFI_NOT_FOUND;
-
+  Bus = PhyMdioGetBus (PhyDriver->MacBaseAddress);
+  if (Bus != NULL) {
+    Bus->ClaimedMask &= ~(1U << PhyDriver->PhyAddr);
+  }
+  PhyDriver->PhyAddr = PHY_ADDR_NONE;
 }
 
 /**
-	Phy devices config,common config ,AR8035 or KSZ9031 config.
-	1.phy soft reset
-	2.phy special config,AR8035 or KSZ9031
-	3.Configure AN and Advertise
+	Add a phy instance to the instance table. An instance initialized again
+	keeps its entry and gives up the MDIO address it claimed before.
 
-	@param PhyDriver			A point to Phy dirver structureM
-	@param MacBaseAddress 		GMAC register base address
+	@param PhyDriver		A point to Phy dirver structure
 
-	@retval EFI_SUCCESS		    Success to config phy.
-	@retval EFI_DEVICE_ERROR	Fail to config phy.
+	@retval EFI_SUCCESS	    		The instance is registered.
+	@retval EFI_OUT_OF_RESOURCES	The instance table is full.
 **/
+STATIC
 EFI_STATUS
-EFIAPI
-PhyConfig (
-  IN  PHY_DRIVER   *PhyDriver,
-  IN  UINTN        MacBaseAddress
+PhyRegisterInstance (
+  IN PHY_DRIVER   *PhyDriver
   )
 {
-  EFI_STATUS  Status;
-  UINT32 value;
-  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
-
-  Status = PhySoftReset (PhyDriver, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-    return EFI_DEVICE_ERROR;
+  UINTN    Index;
+  UINTN    Free;
+
+  Free = PHY_INSTANCE_MAX;
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mPhyInstances[Index] == PhyDriver) {
+      PhyStopLinkBringUp (PhyDriver);
+      PhyReleaseAddress (PhyDriver);
+      return EFI_SUCCESS;
+    }
+    if (Free == PHY_INSTANCE_MAX && mPhyInstances[Index] == NULL) {
+      Free = Index;
+    }
+  }
+  if (Free == PHY_INSTANCE_MAX) {
+    DEBUG ((DEBUG_ERROR, "SNP:PHY: Too many PHY instances\r\n"));
+    return EFI_OUT_OF_RESOURCES;
   }
-  #ifdef PHY_RTL8211F
-        DEBUG ((DEBUG_INFO, "SNP:PHY: begin config phy RTL8211\r\n"));
-        PhyWrite(PhyDriver->PhyAddr, PHY_SPECIAL_PHY_CTLR, LCR_PAGE, MacBaseAddress);
-        PhyWrite(PhyDriver->PhyAddr, LCR_REG, 0xC102, MacBaseAddress);
-        PhyWrite(PhyDriver->PhyAddr, EEELCR_REG, 0x0000, MacBaseAddress);
-        PhyWrite(PhyDriver->PhyAddr, PHY_SPECIAL_PHY_CTLR, 0x0000, MacBaseAddress);
-       
-  #endif
-  #ifdef PHY_AR8035
-	  DEBUG ((DEBUG_INFO, "SNP:PHY: begin config phy AR8035!\r\n"));
-	  // ar8035 mmd reg 0x0B bit15 set 0,close hibernate
-	  PhyWrite(PhyDriver->PhyAddr, 0x1d, 0x0B,MacBaseAddress);
-	  Status = PhyRead(PhyDriver->PhyAddr,0x1e,&value,MacBaseAddress);
-	  PhyWrite(PhyDriver->PhyAddr, 0x1e, (value&0x7FFF),MacBaseAddress);
-	  Status = PhyRead(PhyDriver->PhyAddr,0x1e,&value,MacBaseAddress);
-
-
-  #endif
-  #ifdef PHY_KSZ9031
-  	  DEBUG ((DEBUG_INFO, "SNP:PHY: begin config phy AR8035!\r\n"));
-  	  //
-	  // Configure TX/RX Skew
-      //
-	  PhyConfigSkew (PhyDriver, MacBaseAddress);
-      //
-	  // Read back and display Skew settings
-      //
-	  PhyDisplayConfigSkew (PhyDriver, MacBaseAddress);
-      //
-	  // Configure AN FLP Burst Trasmit timing interval
-      //
-	  PhyConfigFlpBurstTiming (PhyDriver, MacBaseAddress);
-	  PhyDisplayFlpBurstTiming (PhyDriver, MacBaseAddress);
-  #endif
-  // Configure AN and Advertise
-  PhyAutoNego (PhyDriver, MacBaseAddress);
 
+  // A new instance owns no timer yet, the structure may not be zeroed
+  PhyDriver->LinkTimer = NULL;
+  mPhyInstances[Free] = PhyDriver;
   return EFI_SUCCESS;
 }
 
 /**
-	Perform PHY software reset.
-
-	@param PhyDriver			  A point to Phy dirver structure
-	@param MacBaseAddress 	 	  GMAC register base address
+	Forget the GMAC configuration of a port after the EMAC was reinitialized,
+	by the Reset () or Initialize () service of the Simple Network Protocol.
+	The next resolved link programs speed, duplex and flow control again.
+	The reset also cleared the GMAC MMC counters, they are sampled from the
+	cleared values on.
 
-	@retval EFI_SUCCESS		  	  Success to soft reset phy.
-	@retval EFI_TIMEOUT	  		  timeout to soft reset phy.
+	@param PhyDriver		A point to Phy dirver structure
 **/
-EFI_STATUS
+VOID
 EFIAPI
-PhySoftReset (
-  IN PHY_DRIVER   *PhyDriver,
-  IN UINTN        MacBaseAddress
+PhyEmacReinitialized (
+  IN  PHY_DRIVER   *PhyDriver
   )
 {
-  UINT32        TimeOut;
-  UINT32        Data32;
-  EFI_STATUS    Status;
-
-  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
+  PhyDriver->MacConfigValid = FALSE;
+  EmacMmcRebase (&PhyDriver->Counters.Mmc, PhyDriver->MacBaseAddress);
+}
 
-  // PHY Basic Control Register reset
-  PhyWrite (PhyDriver->PhyAddr, PHY_BASIC_CTRL, PHYCTRL_RESET, MacBaseAddress);
+/**
+	Stop a phy instance and remove it from the instance table, its MDIO
+	address becomes available to other ports on a shared bus and the GMAC
+	is detached from the bus. A board reusing the port attaches it again.
 
-  // Wait for completion
-  TimeOut = 0;
-  do {
-    // Read PHY_BASIC_CTRL register from PHY
-    Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_CTRL, &Data32, MacBaseAddress);
-    if (EFI_ERROR(Status)) {
-      return Status;
-    }
-    // Wait until PHYCTRL_RESET become zero
-    if ((Data32 & PHYCTRL_RESET) == 0) {
-      break;
+	@param PhyDriver		A point to Phy dirver structure
+**/
+VOID
+EFIAPI
+PhyDxeRelease (
+  IN  PHY_DRIVER   *PhyDriver
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mPhyInstances[Index] == PhyDriver) {
+      PhyStopLinkBringUp (PhyDriver);
+      PhyRestoreDefaultPage (PhyDriver, PhyDriver->MacBaseAddress);
+      PhyReleaseAddress (PhyDriver);
+      PhyMdioDetach (PhyDriver->MacBaseAddress);
+      mPhyInstances[Index] = NULL;
+      return;
     }
-    MicroSecondDelay(1);
-  } while (TimeOut++ < PHY_TIMEOUT);
-  if (TimeOut >= PHY_TIMEOUT) {
-    DEBUG ((DEBUG_INFO, "SNP:PHY: ERROR! PhySoftReset timeout\n"));
-    return EFI_TIMEOUT;
   }
-
-  return EFI_SUCCESS;
 }
 
-
 /**
-	Read the phy devices ID.
+	Load the PHY address detected on the previous boot for this GMAC.
 
-	@param PhyAddr			    The phy address
-	@param MacBaseAddress 		GMAC register base address
+	@param MacBaseAddress     GMAC register base address
+	@param PhyAddr            The saved phy address
 
-	@retval EFI_SUCCESS			Success to read phy ID.
+	@retval EFI_SUCCESS       A valid phy address was loaded.
+	@retval EFI_NOT_FOUND     No phy address has been saved yet.
 **/
+STATIC
 EFI_STATUS
-EFIAPI
-PhyReadId (
-  IN UINT32   PhyAddr,
-  IN UINTN    MacBaseAddress
+PhyLoadAddress (
+  IN  UINTN        MacBaseAddress,
+  OUT UINT32       *PhyAddr
   )
 {
-  EFI_STATUS    Status;
-  UINT32        PhyId1;
-  UINT32        PhyId2;
-
-  Status = PhyRead (PhyAddr, PHY_ID1, &PhyId1, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-      return Status;
-  }
-  Status = PhyRead (PhyAddr, PHY_ID2, &PhyId2, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-      return Status;
-  }
+  EFI_STATUS   Status;
+  CHAR16       Name[PHY_VARIABLE_NAME_SIZE];
+  UINTN        Size;
 
-  if (PhyId1 == PHY_INVALID_ID || PhyId2 == PHY_INVALID_ID) {
+  UnicodeSPrint (Name, sizeof (Name), PHY_ADDR_VARIABLE_NAME, (UINT64)MacBaseAddress);
+  Size = sizeof (UINT32);
+  Status = gRT->GetVariable (Name, &mPhyDxeVariableGuid, NULL, &Size, PhyAddr);
+  if (EFI_ERROR (Status) || Size != sizeof (UINT32) || *PhyAddr >= PHY_MAX_ADDR) {
     return EFI_NOT_FOUND;
   }
 
-  DEBUG ((DEBUG_INFO, "SNP:PHY: Ethernet PHY detected. PHY_ID1=0x%04X, PHY_ID2=0x%04X, PHY_ADDR=0x%02X\r\n",
-          PhyId1, PhyId2, PhyAddr));
   return EFI_SUCCESS;
 }
 
 /**
-	Config Phy Skew function.
+	Save the detected PHY address so the next boot probes it first.
 
-	@param PhyDriver		  A point to Phy dirver structure
-	@param MacBaseAddress 	  GMAC register base address
+	@param MacBaseAddress     GMAC register base address
+	@param PhyAddr            The phy address to save
+
+	@retval EFI_SUCCESS       The phy address was saved.
 **/
-VOID
-EFIAPI
-PhyConfigSkew (
-  IN PHY_DRIVER   *PhyDriver,
-  IN UINTN        MacBaseAddress
+STATIC
+EFI_STATUS
+PhySaveAddress (
+  IN UINTN        MacBaseAddress,
+  IN UINT32       PhyAddr
   )
 {
-  Phy9031ExtendedWrite (PhyDriver,
-                        PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-                        PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG,
-                        PHY_KSZ9031RN_CONTROL_PAD_SKEW_VALUE,
-                        MacBaseAddress);
-  Phy9031ExtendedWrite (PhyDriver,
-                        PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-                        PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CLK_PAD_SKEW_REG,
-                        PHY_KSZ9031RN_CLK_PAD_SKEW_VALUE,
-                        MacBaseAddress);
-  Phy9031ExtendedWrite (PhyDriver,
-                        PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-                        PHY_KSZ9031RN_DEV_ADDR,
-                        PHY_KSZ9031RN_RX_DATA_PAD_SKEW_REG,
-                        PHY_KSZ9031RN_RX_DATA_PAD_SKEW_VALUE,
-                        MacBaseAddress);
-  Phy9031ExtendedWrite (PhyDriver,
-                        PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-                        PHY_KSZ9031RN_DEV_ADDR,
-                        PHY_KSZ9031RN_TX_DATA_PAD_SKEW_REG,
-                        PHY_KSZ9031RN_TX_DATA_PAD_SKEW_VALUE,
-                        MacBaseAddress);
+  CHAR16       Name[PHY_VARIABLE_NAME_SIZE];
+
+  UnicodeSPrint (Name, sizeof (Name), PHY_ADDR_VARIABLE_NAME, (UINT64)MacBaseAddress);
+  return gRT->SetVariable (Name, &mPhyDxeVariableGuid,
+                           EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                           sizeof (UINT32), &PhyAddr);
 }
 
 /**
-	Read Phy Skew function configuration.
+	Load the link resolved on the previous boot for this GMAC.
 
-	@param PhyDriver		A point to Phy dirver structure
-	@param MacBaseAddress 	GMAC register base address
+	@param MacBaseAddress     GMAC register base address
+	@param Link               PHY_LINK_PACK value
+
+	@retval EFI_SUCCESS       A valid link was loaded.
+	@retval EFI_NOT_FOUND     No link has been saved yet.
 **/
-VOID
-EFIAPI
-PhyDisplayConfigSkew (
-  IN PHY_DRIVER   *PhyDriver,
-  IN UINTN        MacBaseAddress
+STATIC
+EFI_STATUS
+PhyLoadLink (
+  IN  UINTN        MacBaseAddress,
+  OUT UINT32       *Link
   )
 {
-  // Display skew configuration
-  DEBUG ((DEBUG_INFO, "SNP:PHY: Control Signal Pad Skew = 0x%04X\r\n",
-          Phy9031ExtendedRead (PhyDriver, PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-          PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG, MacBaseAddress)));
+  EFI_STATUS   Status;
+  CHAR16       Name[PHY_VARIABLE_NAME_SIZE];
+  UINTN        Size;
+  UINT32       Speed;
 
-  DEBUG ((DEBUG_INFO, "SNP:PHY: RGMII Clock Pad Skew    = 0x%04X\r\n",
-          Phy9031ExtendedRead (PhyDriver, PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-          PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CLK_PAD_SKEW_REG, MacBaseAddress)));
+  UnicodeSPrint (Name, sizeof (Name), PHY_LINK_VARIABLE_NAME, (UINT64)MacBaseAddress);
+  Size = sizeof (UINT32);
+  Status = gRT->GetVariable (Name, &mPhyDxeVariableGuid, NULL, &Size, Link);
+  if (EFI_ERROR (Status) || Size != sizeof (UINT32)) {
+    return EFI_NOT_FOUND;
+  }
 
-  DEBUG ((DEBUG_INFO, "SNP:PHY: RGMII RX Data Pad Skew  = 0x%04X\r\n",
-          Phy9031ExtendedRead (PhyDriver, PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-          PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_RX_DATA_PAD_SKEW_REG, MacBaseAddress)));
+  Speed = PHY_LINK_SPEED (*Link);
+  if ((Speed != SPEED_10 && Speed != SPEED_100 && Speed != SPEED_1000) ||
+      PHY_LINK_DUPLEX (*Link) > DUPLEX_FULL) {
+    return EFI_NOT_FOUND;
+  }
 
-  DEBUG ((DEBUG_INFO, "SNP:PHY: RGMII TX Data Pad Skew  = 0x%04X\r\n",
-          Phy9031ExtendedRead (PhyDriver, PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-          PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_TX_DATA_PAD_SKEW_REG, MacBaseAddress)));
+  return EFI_SUCCESS;
 }
 
 /**
-	Config Phy AN FLP Burst Transmit.
+	Save the resolved link so the next boot programs the GMAC up front.
 
-	@param PhyDriver		A point to Phy dirver structure
-	@param MacBaseAddress 	GMAC register base address
+	@param MacBaseAddress     GMAC register base address
+	@param Link               PHY_LINK_PACK value
+
+	@retval EFI_SUCCESS       The link was saved.
 **/
-VOID
-EFIAPI
-PhyConfigFlpBurstTiming (
-  IN PHY_DRIVER   *PhyDriver,
-  IN UINTN        MacBaseAddress
+STATIC
+EFI_STATUS
+PhySaveLink (
+  IN UINTN        MacBaseAddress,
+  IN UINT32       Link
   )
 {
-  Phy9031ExtendedWrite (PhyDriver,
-                        PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-                        PHY_KSZ9031RN_MMD_DEV_ADDR_00,
-                        PHY_KSZ9031RN_MMD_D0_FLP_LO_REG,
-                        PHY_KSZ9031RN_MMD_D0_FLP_16MS_LO,
-                        MacBaseAddress);
-  Phy9031ExtendedWrite (PhyDriver,
-                        PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-                        PHY_KSZ9031RN_MMD_DEV_ADDR_00,
-                        PHY_KSZ9031RN_MMD_D0_FLP_HI_REG,
-                        PHY_KSZ9031RN_MMD_D0_FLP_16MS_HI,
-                        MacBaseAddress);
+  CHAR16       Name[PHY_VARIABLE_NAME_SIZE];
+
+  UnicodeSPrint (Name, sizeof (Name), PHY_LINK_VARIABLE_NAME, (UINT64)MacBaseAddress);
+  return gRT->SetVariable (Name, &mPhyDxeVariableGuid,
+                           EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                           sizeof (UINT32), &Link);
 }
 
 /**
-	Read Phy AN FLP Burst Transmit configuration.
+	Load the link mode of a GMAC port, PHY_LINK_MODE unless the port
+	overrides it.
 
-	@param PhyDriver	    A point to Phy dirver structure
-	@param MacBaseAddress   GMAC register base address
+	@param MacBaseAddress     GMAC register base address
+
+	@retval                   PHY_LINK_MODE_xxx of the port
 **/
-VOID
-EFIAPI
-PhyDisplayFlpBurstTiming (
-  IN PHY_DRIVER   *PhyDriver,
+STATIC
+UINT8
+PhyLoadLinkMode (
   IN UINTN        MacBaseAddress
   )
 {
-  // Display Auto-Negotiation FLP burst transmit timing
-  DEBUG ((DEBUG_INFO, "SNP:PHY: AN FLP Burst Transmit - LO = 0x%04X\r\n",
-          Phy9031ExtendedRead (PhyDriver, PHY_KSZ9031_MOD_DATA_NO_POST_INC,
-          PHY_KSZ9031RN_MMD_DEV_ADDR_00, PHY_KSZ9031RN_MMD_D0_FLP_LO_REG, MacBaseAddress)));
-  DEBUG ((DEBUG_INFO, "SNP:PHY: AN FLP Burst Transmit - HI = 0x%04X\r\n",
-          Phy9031ExtendedRead (PhyDriver, PHY_KSZ9031_MOD_DATA_NO_POST_INC, PHY_KSZ9031RN_MMD_DEV_ADDR_00,
-          PHY_KSZ9031RN_MMD_D0_FLP_HI_REG, MacBaseAddress)));
+  EFI_STATUS   Status;
+  CHAR16       Name[PHY_VARIABLE_NAME_SIZE];
+  UINTN        Size;
+  UINT8        Mode;
+
+  UnicodeSPrint (Name, sizeof (Name), PHY_LINK_MODE_VARIABLE_NAME, (UINT64)MacBaseAddress);
+  Size = sizeof (Mode);
+  Status = gRT->GetVariable (Name, &mPhyDxeVariableGuid, NULL, &Size, &Mode);
+  if (EFI_ERROR (Status) || Size != sizeof (Mode) || Mode >= PHY_LINK_MODE_MAX) {
+    return PHY_LINK_MODE;
+  }
+
+  if (Mode != PHY_LINK_MODE) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Link mode %d of the port\r\n", Mode));
+  }
+  return Mode;
 }
 
 /**
-	Do phy auto-negotiation.
-	1.Read PHY Status
-	2.Read PHY Auto-Nego Advertise capabilities register for 10/100 Base-T
-	3.Set Advertise capabilities for 10Base-T/10Base-T full-duplex/100Base-T/100Base-T full-duplex
-	4.Set Advertise capabilities for 1000 Base-T/1000 Base-T full-duplex
-	5.Enable and restart Auto-Negotiation.
+	Detect phy devices.
+	1.probe the phy address given to PhyMdioAttach for this port
+	2.probe the phy address saved on the previous boot
+	3.scan the MDIO bus, once for all ports attached to it
+	On a shared bus the mapping of ports to PHYs is board wiring, so only
+	the address given to PhyMdioAttach is probed there. On a private bus that
+	address is a hint, the other probes run when no PHY answers at it.
 
-	@param PhyDriver	    A point to Phy dirver structure
-	@param MacBaseAddress   GMAC register base address
+	@param PhyDriver		  A point to Phy dirver structureM
+	@param MacBaseAddress     GMAC register base address
 
-	@retval EFI_SUCCESS		auto-negotiation config success.
-	@retval EFI_DEVICE_ERROR	Auto-negotiation is not supported
+	@retval EFI_SUCCESS			 The phy interface was detected.
+	@retval EFI_NOT_FOUND	     Fail to detect ethernet phy.
 **/
 EFI_STATUS
 EFIAPI
-PhyAutoNego (
+PhyDetectDevice (
   IN PHY_DRIVER   *PhyDriver,
   IN UINTN        MacBaseAddress
   )
 {
-  EFI_STATUS    Status;
-  UINT32        PhyControl;
-  UINT32        PhyStatus;
-  UINT32        Features;
+  PHY_MDIO_BUS *Bus;
+  UINT32       PhyAddr;
+  UINT32       SavedAddr;
+  UINT32       PortAddr;
+  UINT32       PhyId;
+  UINT32       Free;
+  EFI_STATUS   Status;
 
   DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
 
-  // Read PHY Status
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &PhyStatus, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  Bus = PhyMdioGetBus (MacBaseAddress);
+  if (Bus == NULL) {
+    DEBUG ((DEBUG_ERROR, "SNP:PHY: No MDIO bus for GMAC 0x%lx\r\n", (UINT64)MacBaseAddress));
+    return EFI_NOT_FOUND;
   }
 
-  // Check PHY Status if auto-negotiation is supported
-  if ((PhyStatus & PHYSTS_AUTO_CAP) == 0) {
-    DEBUG ((DEBUG_INFO, "SNP:PHY: Auto-negotiation is not supported.\n"));
-    return EFI_DEVICE_ERROR;
+  PortAddr = PhyMdioGetPortAddress (MacBaseAddress);
+  if (PortAddr < PHY_MAX_ADDR) {
+    if (Bus->ClaimedMask & (1U << PortAddr)) {
+      DEBUG ((DEBUG_ERROR, "SNP:PHY: PHY address 0x%02X is owned by another port\r\n", PortAddr));
+    } else if (EFI_ERROR (PhyReadId (PortAddr, &PhyId, MacBaseAddress))) {
+      DEBUG ((DEBUG_INFO, "SNP:PHY: No PHY at address 0x%02X\r\n", PortAddr));
+    } else {
+      PhyAddr = PortAddr;
+      goto Detected;
+    }
   }
 
-  // Read PHY Auto-Nego Advertise capabilities register for 10/100 Base-T
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_AUTO_NEG_ADVERT, &Features, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  if (PhyMdioIsShared (Bus, MacBaseAddress)) {
+    if (PortAddr >= PHY_MAX_ADDR) {
+      DEBUG ((DEBUG_ERROR, "SNP:PHY: GMAC 0x%lx is on a shared MDIO bus without a PHY address\r\n",
+              (UINT64)MacBaseAddress));
+    }
+    return EFI_NOT_FOUND;
   }
 
-  // Set Advertise capabilities for 10Base-T/10Base-T full-duplex/100Base-T/100Base-T full-duplex
-  Features |= (PHYANA_10BASET | PHYANA_10BASETFD | PHYANA_100BASETX | PHYANA_100BASETXFD);
-  PhyWrite (PhyDriver->PhyAddr, PHY_AUTO_NEG_ADVERT, Features, MacBaseAddress);
+  Status = PhyLoadAddress (MacBaseAddress, &SavedAddr);
+  if (!EFI_ERROR (Status) && !(Bus->ClaimedMask & (1U << SavedAddr)) &&
+      !EFI_ERROR (PhyReadId (SavedAddr, &PhyId, MacBaseAddress))) {
+    PhyAddr = SavedAddr;
+    goto Detected;
+  }
 
-  // Read PHY Auto-Nego Advertise capabilities register for 1000 Base-T
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_1000BASE_T_CONTROL, &Features, MacBaseAddress);
+  PhyMdioScan (Bus);
+  Free = Bus->PresentMask & ~Bus->ClaimedMask;
+  for (PhyAddr = 0; PhyAddr < PHY_MAX_ADDR; PhyAddr++) {
+    if (Free & (1U << PhyAddr)) {
+      PhyId = Bus->PhyId[PhyAddr];
+      goto Found;
+    }
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: Fail to detect Ethernet PHY!\r\n"));
+  return EFI_NOT_FOUND;
+
+Found:
+  Status = PhySaveAddress (MacBaseAddress, PhyAddr);
   if (EFI_ERROR (Status)) {
-    return Status;
+    DEBUG ((DEBUG_WARN, "SNP:PHY: Fail to save PHY address - %r\r\n", Status));
   }
 
-  // Set Advertise capabilities for 1000 Base-T/1000 Base-T full-duplex
-  Features |= (PHYADVERTISE_1000FULL | PHYADVERTISE_1000HALF);
-  PhyWrite (PhyDriver->PhyAddr, PHY_1000BASE_T_CONTROL, Features, MacBaseAddress);
+Detected:
+  Bus->PresentMask |= 1U << PhyAddr;
+  Bus->ClaimedMask |= 1U << PhyAddr;
+  Bus->PhyId[PhyAddr] = PhyId;
+  PhyDriver->PhyAddr = PhyAddr;
+  PhyDriver->PhyId = PhyId;
+  PhyDriver->Ops = PhyFindOps (PhyId);
+  DEBUG ((DEBUG_INFO, "SNP:PHY: %a PHY at address 0x%02X\r\n", PhyDriver->Ops->Name, PhyAddr));
+  return EFI_SUCCESS;
+}
 
-  // Read control register
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_CTRL, &PhyControl, MacBaseAddress);
+/**
+	Phy devices config,common config ,AR8035 or KSZ9031 config.
+	1.phy soft reset
+	2.phy special config,AR8035 or KSZ9031
+	3.Configure AN and Advertise
+
+	@param PhyDriver			A point to Phy dirver structureM
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Success to config phy.
+	@retval EFI_DEVICE_ERROR	Fail to config phy.
+**/
+EFI_STATUS
+EFIAPI
+PhyConfig (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
+
+  PERF_START_EX (gImageHandle, PHY_PERF_RESET, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
+  Status = PhySoftReset (PhyDriver, MacBaseAddress);
+  PERF_END_EX (gImageHandle, PHY_PERF_RESET, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
   if (EFI_ERROR (Status)) {
-    return Status;
+    return EFI_DEVICE_ERROR;
   }
-  // Enable Auto-Negotiation
-  PhyControl |= PHYCTRL_AUTO_EN;
-  // Restart auto-negotiation
-  PhyControl |= PHYCTRL_RST_AUTO;
-  // Write this configuration
-  PhyWrite (PhyDriver->PhyAddr, PHY_BASIC_CTRL, PhyControl, MacBaseAddress);
+
+  PERF_START_EX (gImageHandle, PHY_PERF_VENDOR_CONFIG, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
+  PhyVendorConfig (PhyDriver, MacBaseAddress);
+  PERF_END_EX (gImageHandle, PHY_PERF_VENDOR_CONFIG, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
+
+  // Configure AN and Advertise
+  PERF_START_EX (gImageHandle, PHY_PERF_AUTONEGO, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
+  PhyAutoNego (PhyDriver, MacBaseAddress);
+  PERF_END_EX (gImageHandle, PHY_PERF_AUTONEGO, PHY_PERF_MODULE, 0, PHY_PERF_ID (MacBaseAddress));
 
   return EFI_SUCCESS;
 }
 
 /**
-	Phy link adjust config.
-	1.check phy link status.
-	2.read phy link capability.
-	3.GMAC adjust config.
+	Phy special config, run the config script and operation of the detected PHY.
 
-	@param PhyDriver		A point to Phy dirver structure
-	@param MacBaseAddress   GMAC register base address
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
 
-	@retval EFI_SUCCESS		phy link up.
-	@retval EFI_NOT_READY	phy link down.
+	@retval EFI_SUCCESS		    Success to config phy.
 **/
 EFI_STATUS
 EFIAPI
-PhyLinkAdjustEmacConfig (
-  IN PHY_DRIVER   *PhyDriver,
-  IN UINTN        MacBaseAddress
+PhyVendorConfig (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
   )
 {
-  UINT32       Speed;
-  UINT32       Duplex;
-  EFI_STATUS   Status;
+  EFI_STATUS      Status;
+  CONST PHY_OPS   *Ops;
+
+  Ops = PhyDriver->Ops;
+  if (Ops == NULL) {
+    return EFI_SUCCESS;
+  }
 
+  DEBUG ((DEBUG_INFO, "SNP:PHY: begin config phy %a\r\n", Ops->Name));
   Status = EFI_SUCCESS;
-  Speed = SPEED_10;
-  Duplex = DUPLEX_HALF;
+  if (Ops->ConfigScript != NULL) {
+    Status = PhyRunScript (PhyDriver, Ops->Name, Ops->ConfigScript, Ops->ConfigScriptSize,
+               MacBaseAddress, NULL);
+  }
 
-  DEBUG((EFI_D_ERROR, "%a() Line = %d \n", __FUNCTION__, __LINE__));
-  Status = PhyCheckLinkStatus (PhyDriver, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-    PhyDriver->PhyCurrentLink = LINK_DOWN;
-    DEBUG((EFI_D_ERROR, "%a() Line = %d \n", __FUNCTION__, __LINE__));
-	Status = EFI_NOT_READY;
-  } else {
-    PhyDriver->PhyCurrentLink = LINK_UP;
-    DEBUG((EFI_D_ERROR, "%a() Line = %d \n", __FUNCTION__, __LINE__));
-	Status = EFI_SUCCESS;
+  if (!EFI_ERROR (Status) && Ops->Config != NULL) {
+    Status = Ops->Config (PhyDriver, MacBaseAddress);
   }
 
-  if (PhyDriver->PhyOldLink != PhyDriver->PhyCurrentLink) {
-    if (PhyDriver->PhyCurrentLink == LINK_UP) {
-      DEBUG ((DEBUG_INFO, "SNP:PHY: Link is up - Network Cable is Plugged\r\n"));
-      PhyReadCapability (PhyDriver, &Speed, &Duplex, MacBaseAddress);
-      EmacConfigAdjust (Speed, Duplex, MacBaseAddress);
-      Status = EFI_SUCCESS;
-    } else {
-      DEBUG ((DEBUG_INFO, "SNP:PHY: Link is Down - Network Cable is Unplugged?\r\n"));
-      Status = EFI_NOT_READY;
-    }
-  } else if (PhyDriver->PhyCurrentLink == LINK_DOWN) {
-    Status = EFI_NOT_READY;
+  PhyRestoreDefaultPage (PhyDriver, MacBaseAddress);
+  return Status;
+}
+
+/**
+	Current time in microseconds, from the performance counter.
+**/
+STATIC
+UINT64
+PhyGetTimeUs (
+  VOID
+  )
+{
+  return DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter ()), 1000);
+}
+
+//
+// Performance measurement token of each link bring-up state
+//
+STATIC CONST CHAR8  *mPhyLinkStatePerfToken[] = {
+  NULL,                           // PhyLinkStateIdle
+  PHY_PERF_RESET,                 // PhyLinkStateReset
+  PHY_PERF_VENDOR_CONFIG,         // PhyLinkStateVendorConfig
+  PHY_PERF_AUTONEGO,              // PhyLinkStateAdvertise
+  PHY_PERF_LINK_WAIT,             // PhyLinkStateWaitLink
+  PHY_PERF_AUTONEGO_WAIT,         // PhyLinkStateWaitAutoNego
+  PHY_PERF_ADJUST_MAC,            // PhyLinkStateAdjustMac
+};
+
+/**
+	Enter a new link bring-up state and restart its phase timer.
+	The state phases are recorded as performance measurements.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param State				The new state
+**/
+STATIC
+VOID
+PhyLinkEnterState (
+  IN PHY_DRIVER       *PhyDriver,
+  IN PHY_LINK_STATE   State
+  )
+{
+  if (PhyDriver->LinkState < ARRAY_SIZE (mPhyLinkStatePerfToken) &&
+      mPhyLinkStatePerfToken[PhyDriver->LinkState] != NULL) {
+    PERF_END_EX (gImageHandle, mPhyLinkStatePerfToken[PhyDriver->LinkState], PHY_PERF_MODULE, 0,
+                 PHY_PERF_ID (PhyDriver->MacBaseAddress));
+  }
+  if (State < ARRAY_SIZE (mPhyLinkStatePerfToken) && mPhyLinkStatePerfToken[State] != NULL) {
+    PERF_START_EX (gImageHandle, mPhyLinkStatePerfToken[State], PHY_PERF_MODULE, 0,
+                   PHY_PERF_ID (PhyDriver->MacBaseAddress));
   }
 
-  PhyDriver->PhyOldLink = PhyDriver->PhyCurrentLink;
+  PhyTrace (PhyTraceState, PhyDriver->PhyAddr, State, PhyDriver->LinkState);
 
-  return Status;
+  if (State == PhyLinkStateLinkDown) {
+    PhyDriver->MacConfigValid = FALSE;
+  }
+  PhyDriver->LinkState = State;
+  PhyDriver->PhaseStart = PhyGetTimeUs ();
+  PhyDriver->NextPollTime = PhyDriver->PhaseStart;
+  PhyDriver->PollBackoff = 0;
 }
 
 /**
-	Check phy link status.
-	1.check phy link existed or not.
-	2.wait until Auto Negotiation completed.
+	Check whether the current state may poll the PHY again, the delay between
+	polls backs off from PHY_LINK_POLL_BACKOFF_MIN_US to PHY_LINK_POLL_BACKOFF_MAX_US.
 
-	@param PhyDriver		A point to Phy dirver structure
-	@param MacBaseAddress   GMAC register base address
+	@param PhyDriver			A point to Phy dirver structure
 
-	@retval EFI_SUCCESS		phy link up.
-	@retval EFI_TIMEOUT		phy link down.
+	@retval TRUE				Poll now, the next poll is scheduled.
+	@retval FALSE				Wait for a later timer tick.
 **/
-EFI_STATUS
-EFIAPI
-PhyCheckLinkStatus (
-  IN PHY_DRIVER   *PhyDriver,
-  IN UINTN        MacBaseAddress
+STATIC
+BOOLEAN
+PhyLinkPollDue (
+  IN PHY_DRIVER   *PhyDriver
   )
 {
-  EFI_STATUS    Status;
-  UINT32        Data32;
-  UINTN         TimeOut;
-  UINT32        PhyBasicStatus;
+  UINT64    Now;
 
-  // Get the PHY Status
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &PhyBasicStatus, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  Now = PhyGetTimeUs ();
+  if (Now < PhyDriver->NextPollTime) {
+    return FALSE;
   }
 
-  // if Link is already up then dont need to proceed anymore
-  if (PhyBasicStatus & PHYSTS_LINK_STS) {
-    return EFI_SUCCESS;
+  if (PhyDriver->PollBackoff == 0) {
+    PhyDriver->PollBackoff = PHY_LINK_POLL_BACKOFF_MIN_US;
+  } else {
+    PhyDriver->PollBackoff = MIN (PhyDriver->PollBackoff * 2, PHY_LINK_POLL_BACKOFF_MAX_US);
   }
+  PhyDriver->NextPollTime = Now + PhyDriver->PollBackoff;
+  return TRUE;
+}
 
-  // Wait until it is up or until Time Out
-  TimeOut = 0;
-  do {
-    // Read PHY_BASIC_STATUS register from PHY
-    Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
+/**
+	Poll a PHY register until (Reg & Mask) == Value, bounded by a real-time
+	deadline. The delay between polls starts at PHY_POLL_BACKOFF_MIN_US and
+	doubles up to PHY_POLL_BACKOFF_MAX_US, keeping the MDIO bus mostly idle.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Reg					Phy register
+	@param Mask					Bits to compare
+	@param Value				Expected value of the bits
+	@param TimeoutUs			Deadline, in microseconds from now
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    The register holds the value.
+	@retval EFI_TIMEOUT		    The deadline passed.
+**/
+STATIC
+EFI_STATUS
+PhyPollRegister (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Reg,
+  IN UINT32       Mask,
+  IN UINT32       Value,
+  IN UINT64       TimeoutUs,
+  IN UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        Data32;
+  UINT64        Start;
+  UINT64        Elapsed;
+  UINT64        Delay;
+
+  Start = PhyGetTimeUs ();
+  Delay = PHY_POLL_BACKOFF_MIN_US;
+  for (;;) {
+    Status = PhyRead (PhyDriver->PhyAddr, Reg, &Data32, MacBaseAddress);
     if (EFI_ERROR (Status)) {
       return Status;
     }
-    // Wait until PHYSTS_LINK_STS become one
-    if (Data32 & PHYSTS_LINK_STS) {
-      // Link is up
-      break;
+    if ((Data32 & Mask) == Value) {
+      return EFI_SUCCESS;
     }
-    MicroSecondDelay (1);
-  } while (TimeOut++ < PHY_TIMEOUT);
-  if (TimeOut >= PHY_TIMEOUT) {
-    // Link is down
-    return EFI_TIMEOUT;
-  }
 
-  // Wait until autonego process has completed
-  TimeOut = 0;
-  do {
-    // Read PHY_BASIC_STATUS register from PHY
-    Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
-    if (EFI_ERROR(Status)) {
-      return Status;
-    }
-    // Wait until PHYSTS_AUTO_COMP become one
-    if (Data32 & PHYSTS_AUTO_COMP) {
-      DEBUG ((DEBUG_INFO, "SNP:PHY: Auto Negotiation completed\r\n"));
-      break;
+    Elapsed = PhyGetTimeUs () - Start;
+    if (Elapsed >= TimeoutUs) {
+      return EFI_TIMEOUT;
     }
-    MicroSecondDelay (1);
-  } while (TimeOut++ < PHY_TIMEOUT);
-  if (TimeOut >= PHY_TIMEOUT) {
-    DEBUG ((DEBUG_INFO, "SNP:PHY: Error! Auto Negotiation timeout\n"));
-    return EFI_TIMEOUT;
+    MicroSecondDelay ((UINTN)MIN (Delay, TimeoutUs - Elapsed));
+    Delay = MIN (Delay * 2, PHY_POLL_BACKOFF_MAX_US);
   }
+}
 
-  return EFI_SUCCESS;
+/**
+	Run one step of the link bring-up state machine.
+	A step never waits, it samples the PHY at most once and moves on.
+
+	@param PhyDriver			A point to Phy dirver structure
+
+	@retval TRUE				The next state can run right away.
+	@retval FALSE				Wait for the next timer tick.
+**/
+STATIC
+BOOLEAN
+PhyLinkStep (
+  IN PHY_DRIVER   *PhyDriver
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        Data32;
+  UINT32        Link;
+  UINT32        Speed;
+  UINT32        Duplex;
+  UINT64        Elapsed;
+  UINTN         MacBaseAddress;
+
+  MacBaseAddress = PhyDriver->MacBaseAddress;
+  Elapsed = PhyGetTimeUs () - PhyDriver->PhaseStart;
+
+  switch (PhyDriver->LinkState) {
+    case PhyLinkStateReset:
+      Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_CTRL, &Data32, MacBaseAddress);
+      if (!EFI_ERROR (Status) && (Data32 & PHYCTRL_RESET) == 0) {
+        PhyLinkEnterState (PhyDriver, PhyLinkStateVendorConfig);
+        return TRUE;
+      }
+      if (Elapsed >= PHY_RESET_TIMEOUT_US) {
+        DEBUG ((DEBUG_INFO, "SNP:PHY: ERROR! PhySoftReset timeout\n"));
+        PhyLinkEnterState (PhyDriver, PhyLinkStateError);
+      }
+      return FALSE;
+
+    case PhyLinkStateVendorConfig:
+      PhyVendorConfig (PhyDriver, MacBaseAddress);
+      PhyLinkEnterState (PhyDriver, PhyLinkStateAdvertise);
+      return TRUE;
+
+    case PhyLinkStateAdvertise:
+      Status = PhyAutoNego (PhyDriver, MacBaseAddress);
+      if (EFI_ERROR (Status)) {
+        PhyLinkEnterState (PhyDriver, PhyLinkStateError);
+        return FALSE;
+      }
+      PhyLinkEnterState (PhyDriver, PhyLinkStateWaitLink);
+      return FALSE;
+
+    case PhyLinkStateWaitLink:
+    case PhyLinkStateWaitAutoNego:
+      if (!PhyLinkPollDue (PhyDriver)) {
+        return FALSE;
+      }
+      Status = PhyMdioPollRead (PhyDriver, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
+      if (EFI_ERROR (Status)) {
+        Data32 = 0;
+      }
+      // A forced link has no auto-negotiation to wait for
+      if ((Data32 & PHYSTS_LINK_STS) != 0 &&
+          ((Data32 & PHYSTS_AUTO_COMP) != 0 || (PhyLinkModeSetting (PhyDriver)->Control & PHYCTRL_AUTO_EN) == 0)) {
+        DEBUG ((DEBUG_INFO, "SNP:PHY: Auto Negotiation completed\r\n"));
+        PhyLinkEnterState (PhyDriver, PhyLinkStateAdjustMac);
+        return TRUE;
+      }
+      if (PhyDriver->LinkState == PhyLinkStateWaitLink) {
+        if ((Data32 & PHYSTS_LINK_STS) != 0) {
+          PhyLinkEnterState (PhyDriver, PhyLinkStateWaitAutoNego);
+        } else if (Elapsed >= PHY_LINK_TIMEOUT_US) {
+          DEBUG ((DEBUG_INFO, "SNP:PHY: Link is Down - Network Cable is Unplugged?\r\n"));
+          PhyLinkEnterState (PhyDriver, PhyLinkStateLinkDown);
+        }
+      } else if (Elapsed >= PHY_AUTONEGO_TIMEOUT_US) {
+        DEBUG ((DEBUG_INFO, "SNP:PHY: Error! Auto Negotiation timeout\n"));
+        PhyLinkEnterState (PhyDriver, PhyLinkStateLinkDown);
+      }
+      return FALSE;
+
+    case PhyLinkStateAdjustMac:
+      Status = PhyReadStatus (PhyDriver, &Link, &Speed, &Duplex, MacBaseAddress);
+      if (EFI_ERROR (Status) || Link == LINK_DOWN) {
+        PhyLinkEnterState (PhyDriver, PhyLinkStateWaitLink);
+        return FALSE;
+      }
+      // A downshifted link is retrained before it is reported
+      if (PhyCheckLinkQuality (PhyDriver, Speed, FALSE, MacBaseAddress)) {
+        PhyLinkEnterState (PhyDriver, PhyLinkStateWaitLink);
+        return FALSE;
+      }
+      PhyDisplayAbility (Speed, Duplex);
+      PhyAdjustMac (PhyDriver, Speed, Duplex, MacBaseAddress);
+      DEBUG ((DEBUG_INFO, "SNP:PHY: Link is up - Network Cable is Plugged\r\n"));
+      DEBUG ((DEBUG_INFO, "SNP:PHY: MDIO %ld reads, %ld writes, %ld busy polls, %ld timeouts\r\n",
+              PhyDriver->MdioCounters.Reads, PhyDriver->MdioCounters.Writes,
+              PhyDriver->MdioCounters.BusyPolls, PhyDriver->MdioCounters.Timeouts));
+      PhyDriver->PhyCurrentLink = LINK_UP;
+      PhyDriver->PhyOldLink = LINK_UP;
+      PhyDriver->LastPollTime = PhyGetTimeUs ();
+      PhyDriver->PollInterval = PHY_POLL_INTERVAL_MIN_US;
+      PhyLinkEnterState (PhyDriver, PhyLinkStateLinkUp);
+      return FALSE;
+
+    default:
+      return FALSE;
+  }
 }
 
 /**
-	Read phy capability.
+	Timer notification that advances the link bring-up state machine.
+	The timer is cancelled once bring-up has finished.
 
-	@param PhyDriver		A point to Phy dirver structure
-	@param speed			ethernet speed,10M/100M/1000M
-	@param duplex			Duplex mode,half/full
-	@param MacBaseAddress 	GMAC register base address
+	@param Event				The timer event
+	@param Context				A point to Phy dirver structure
+**/
+STATIC
+VOID
+EFIAPI
+PhyLinkTimerNotify (
+  IN EFI_EVENT    Event,
+  IN VOID         *Context
+  )
+{
+  PHY_DRIVER    *PhyDriver;
 
-	@retval EFI_SUCCESS	    Read success
+  PhyDriver = (PHY_DRIVER *)Context;
+
+  while (PhyLinkStep (PhyDriver)) {
+  }
+
+  if (PhyDriver->LinkState >= PhyLinkStateLinkUp) {
+    gBS->SetTimer (Event, TimerCancel, 0);
+    PhyEnableLinkInterrupt (PhyDriver, PhyDriver->MacBaseAddress);
+  }
+}
+
+/**
+	Create the timer event of the link bring-up state machine.
+
+	@param PhyDriver			A point to Phy dirver structure
+
+	@retval EFI_SUCCESS		    The timer event exists.
+	@retval other			    The timer event could not be created.
 **/
+STATIC
 EFI_STATUS
-EFIAPI
-PhyReadCapability (
-  IN PHY_DRIVER   *PhyDriver,
-  OUT UINT32       *Speed,
-  OUT UINT32       *Duplex,
-  IN UINTN        MacBaseAddress
+PhyLinkCreateTimer (
+  IN PHY_DRIVER   *PhyDriver
   )
 {
   EFI_STATUS    Status;
-  UINT32        PartnerAbilityGb;
-  UINT32        AdvertisingGb;
-  UINT32        CommonAbilityGb;
-  UINT32        PartnerAbility;
 
-  // For 1000 Base-T
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_1000BASE_T_STATUS, &PartnerAbilityGb, MacBaseAddress);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  if (PhyDriver->LinkTimer != NULL) {
+    return EFI_SUCCESS;
   }
 
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_1000BASE_T_CONTROL, &AdvertisingGb, MacBaseAddress);
+  Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                  PhyLinkTimerNotify, PhyDriver, &PhyDriver->LinkTimer);
   if (EFI_ERROR (Status)) {
-    return Status;
+    PhyDriver->LinkTimer = NULL;
   }
 
-  CommonAbilityGb = PartnerAbilityGb & (AdvertisingGb << 2);
+  return Status;
+}
 
-  // For 10/100 Base-T
+/**
+	Resume the link bring-up state machine in a given state, without a reset.
 
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_AUTO_NEG_LINK_ABILITY, &PartnerAbility, MacBaseAddress);
+	@param PhyDriver			A point to Phy dirver structure
+	@param State				State to resume in
+	@param PhaseStart			Start of the state in microseconds, 0 for now
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    The state machine runs.
+	@retval other			    The timer event could not be created or armed.
+**/
+STATIC
+EFI_STATUS
+PhyLinkResume (
+  IN PHY_DRIVER       *PhyDriver,
+  IN PHY_LINK_STATE   State,
+  IN UINT64           PhaseStart,
+  IN UINTN            MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+
+  Status = PhyLinkCreateTimer (PhyDriver);
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  // Determine the Speed and Duplex
-  if (PartnerAbilityGb & (PHYLPA_1000FULL | PHYLPA_1000HALF)) {
-    *Speed = SPEED_1000;
-    if (CommonAbilityGb & PHYLPA_1000FULL) {
-      *Duplex = DUPLEX_FULL;
-    }
-	else{
-		*Duplex = DUPLEX_HALF;
-	}
+  PhyDriver->MacBaseAddress = MacBaseAddress;
+  PhyDriver->PhyCurrentLink = LINK_DOWN;
+  PhyDriver->PhyOldLink = LINK_DOWN;
+  PhyLinkEnterState (PhyDriver, State);
+  if (PhaseStart != 0) {
+    PhyDriver->PhaseStart = PhaseStart;
   }
-  else {
-  	if (PartnerAbility & (PHYLPA_100FULL | PHYLPA_100HALF)){
-		*Speed = SPEED_100;
-		if (PartnerAbility & PHYLPA_100FULL) {
-		  *Duplex = DUPLEX_FULL;
-		}
-		else{
-		  *Duplex = DUPLEX_HALF;
-		}
-  	}
-	else  {
-      *Speed = SPEED_10;
-	  	if (PartnerAbility & PHYLPA_10FULL) {
+
+  Status = gBS->SetTimer (PhyDriver->LinkTimer, TimerPeriodic, PHY_LINK_POLL_PERIOD);
+  if (EFI_ERROR (Status)) {
+    PhyDriver->LinkState = PhyLinkStateIdle;
+  }
+
+  return Status;
+}
+
+/**
+	Check whether the PHY kept a link from before this boot with everything
+	this driver would program: auto-negotiation enabled and complete, the
+	speed, PAUSE and EEE advertisement of PhyAutoNego, and the vendor config
+	of the PHY.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval TRUE			    The link can be kept as is.
+**/
+STATIC
+BOOLEAN
+PhyLinkIsPreserved (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  CONST PHY_OPS  *Ops;
+  UINT32         Control;
+  UINT32         Status32;
+  UINT32         Expected;
+  UINT32         Advertise;
+  UINT32         GigControl;
+  BOOLEAN        Preserved;
+  BOOLEAN        AutoNego;
+
+  Preserved = FALSE;
+  Ops = PhyDriver->Ops;
+  AutoNego = (BOOLEAN)((PhyLinkModeSetting (PhyDriver)->Control & PHYCTRL_AUTO_EN) != 0);
+
+  if (EFI_ERROR (PhyShadowRead (PhyDriver, PHY_BASIC_CTRL, &Control, MacBaseAddress)) ||
+      (Control & (PHYCTRL_RESET | PHYCTRL_PD | PHYCTRL_ISOLATE | PHYCTRL_LOOPBK)) != 0) {
+    goto Exit;
+  }
+
+  // Link status is latched low, the second read is the current state
+  Expected = AutoNego ? (PHYSTS_LINK_STS | PHYSTS_AUTO_COMP) : PHYSTS_LINK_STS;
+  if (EFI_ERROR (PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &Status32, MacBaseAddress)) ||
+      EFI_ERROR (PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &Status32, MacBaseAddress)) ||
+      (Status32 & Expected) != Expected) {
+    goto Exit;
+  }
+
+  if (EFI_ERROR (PhyShadowRead (PhyDriver, PHY_AUTO_NEG_ADVERT, &Advertise, MacBaseAddress)) ||
+      EFI_ERROR (PhyShadowRead (PhyDriver, PHY_1000BASE_T_CONTROL, &GigControl, MacBaseAddress)) ||
+      !PhyLinkModeProgrammed (PhyDriver, Control, Advertise, GigControl)) {
+    goto Exit;
+  }
+
+  if (AutoNego && !PhyEeeAdvertised (PhyDriver, MacBaseAddress)) {
+    goto Exit;
+  }
+
+  if (Ops->CheckConfig != NULL) {
+    Preserved = Ops->CheckConfig (PhyDriver, MacBaseAddress);
+  } else if (Ops->ConfigScript != NULL) {
+    Preserved = PhyCheckScript (PhyDriver, Ops->ConfigScript, Ops->ConfigScriptSize, MacBaseAddress);
+  } else {
+    Preserved = (BOOLEAN)(Ops->Config == NULL);
+  }
+
+Exit:
+  if (!Preserved) {
+    PhyShadowInvalidate (PhyDriver);
+  }
+  return Preserved;
+}
+
+/**
+	Find the PHY_AUTONEGO_HOB left for a GMAC before DXE.
+
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval The HOB data, NULL if auto-negotiation was not started for this GMAC.
+**/
+STATIC
+CONST PHY_AUTONEGO_HOB *
+PhyFindAutoNegoHob (
+  IN UINTN        MacBaseAddress
+  )
+{
+  VOID                    *Hob;
+  CONST PHY_AUTONEGO_HOB  *AutoNego;
+
+  for (Hob = GetFirstGuidHob (&mPhyAutoNegoHobGuid);
+       Hob != NULL;
+       Hob = GetNextGuidHob (&mPhyAutoNegoHobGuid, GET_NEXT_HOB (Hob))) {
+    AutoNego = GET_GUID_HOB_DATA (Hob);
+    if (GET_GUID_HOB_DATA_SIZE (Hob) >= sizeof (PHY_AUTONEGO_HOB) &&
+        AutoNego->Version == PHY_AUTONEGO_HOB_VERSION &&
+        AutoNego->MacBaseAddress == MacBaseAddress) {
+      return AutoNego;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+	Adopt auto-negotiation started before DXE. The PHY must be the one the HOB
+	describes, still be negotiating with the HOB advertisement and the EEE
+	advertisement of PHY_EEE_POLICY, and have had its vendor config applied. The state machine then resumes in the link wait
+	with the phase timer started when auto-negotiation was restarted.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Bring-up continues from the adopted negotiation.
+	@retval EFI_NOT_FOUND	    Nothing to adopt, bring-up has to start over.
+**/
+STATIC
+EFI_STATUS
+PhyAdoptLinkBringUp (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  CONST PHY_AUTONEGO_HOB  *AutoNego;
+  UINT32                  Required;
+  UINT32                  Control;
+  UINT32                  Advertise;
+  UINT32                  GigControl;
+  UINT64                  Now;
+  UINT64                  Start;
+
+  AutoNego = PhyFindAutoNegoHob (MacBaseAddress);
+  if (AutoNego == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Required = PHY_HOB_RESET_DONE | PHY_HOB_AUTONEGO;
+  if (PhyDriver->Ops->ConfigScript != NULL || PhyDriver->Ops->Config != NULL) {
+    Required |= PHY_HOB_VENDOR_CONFIG;
+  }
+  if ((AutoNego->Flags & Required) != Required ||
+      AutoNego->PhyAddr != PhyDriver->PhyAddr ||
+      AutoNego->PhyId != PhyDriver->PhyId) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Auto-negotiation HOB does not match, restart\r\n"));
+    return EFI_NOT_FOUND;
+  }
+
+  if (EFI_ERROR (PhyShadowRead (PhyDriver, PHY_BASIC_CTRL, &Control, MacBaseAddress)) ||
+      EFI_ERROR (PhyShadowRead (PhyDriver, PHY_AUTO_NEG_ADVERT, &Advertise, MacBaseAddress)) ||
+      EFI_ERROR (PhyShadowRead (PhyDriver, PHY_1000BASE_T_CONTROL, &GigControl, MacBaseAddress))) {
+    PhyShadowInvalidate (PhyDriver);
+    return EFI_NOT_FOUND;
+  }
+  if ((Control & (PHYCTRL_RESET | PHYCTRL_AUTO_EN)) != PHYCTRL_AUTO_EN ||
+      !PhyLinkModeProgrammed (PhyDriver, Control, Advertise, GigControl) ||
+      (UINT16)Advertise != AutoNego->Advertise ||
+      (UINT16)GigControl != AutoNego->GigControl) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: PHY changed since auto-negotiation was started, restart\r\n"));
+    PhyShadowInvalidate (PhyDriver);
+    return EFI_NOT_FOUND;
+  }
+
+  // The HOB does not cover EEE, a PHY advertising EEE out of reset would
+  // negotiate it against PHY_EEE_POLICY
+  if (!PhyEeeAdvertised (PhyDriver, MacBaseAddress)) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: EEE advertisement does not follow the policy, restart\r\n"));
+    PhyShadowInvalidate (PhyDriver);
+    return EFI_NOT_FOUND;
+  }
+
+  // Count the link wait from the auto-negotiation restart
+  Now = PhyGetTimeUs ();
+  Start = DivU64x32 (AutoNego->AutoNegoStartNs, 1000);
+  if (Start > Now) {
+    Start = Now;
+  }
+
+  if (EFI_ERROR (PhyLinkResume (PhyDriver, PhyLinkStateWaitLink, Start, MacBaseAddress))) {
+    PhyShadowInvalidate (PhyDriver);
+    return EFI_NOT_FOUND;
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: Adopted auto-negotiation started %ld us ago\r\n", Now - Start));
+  return EFI_SUCCESS;
+}
+
+/**
+	Issue the PHY reset selected by PHY_RESET_MODE, completion is not awaited.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    The reset was issued.
+	@retval EFI_UNSUPPORTED	    PHY_RESET_MODE asks for no reset.
+**/
+STATIC
+EFI_STATUS
+PhyResetStart (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+
+  if ((PHY_RESET_MODE & (PHY_RESET_PMT | PHY_RESET_BCR)) == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((PHY_RESET_MODE & PHY_RESET_PMT) != 0) {
+    Status = PhyShadowWrite (PhyDriver, PHY_BASIC_CTRL, PHYCTRL_PD, MacBaseAddress);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    MicroSecondDelay (PHY_RESET_PMT_DELAY_US);
+  }
+
+  // PHY Basic Control Register reset, this also drops the shadow copy and
+  // restarts the roll-over error counters from zero
+  PhyDriver->Counters.RxErrorLast = 0;
+  return PhyShadowWrite (PhyDriver, PHY_BASIC_CTRL, PHYCTRL_RESET, MacBaseAddress);
+}
+
+/**
+	Start non-blocking link bring-up.
+	Issue the PHY soft reset and let a periodic timer event run vendor config,
+	advertisement, link and auto-negotiation waits and the GMAC adjustment.
+	Use PhyGetLinkState to query the progress.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Bring-up was started.
+	@retval other			    The timer event could not be created or armed.
+**/
+EFI_STATUS
+EFIAPI
+PhyStartLinkBringUp (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
+
+  PhyDriver->MacBaseAddress = MacBaseAddress;
+
+  Status = PhyLinkCreateTimer (PhyDriver);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  PhyDriver->PhyCurrentLink = LINK_DOWN;
+  PhyDriver->PhyOldLink = LINK_DOWN;
+
+  // PHY reset, completion is polled by the timer
+  Status = PhyResetStart (PhyDriver, MacBaseAddress);
+  if (Status == EFI_UNSUPPORTED) {
+    PhyLinkEnterState (PhyDriver, PhyLinkStateVendorConfig);
+  } else if (EFI_ERROR (Status)) {
+    return Status;
+  } else {
+    PhyLinkEnterState (PhyDriver, PhyLinkStateReset);
+  }
+
+  Status = gBS->SetTimer (PhyDriver->LinkTimer, TimerPeriodic, PHY_LINK_POLL_PERIOD);
+  if (EFI_ERROR (Status)) {
+    PhyDriver->LinkState = PhyLinkStateIdle;
+  }
+
+  return Status;
+}
+
+/**
+	Stop link bring-up and release the timer event.
+
+	@param PhyDriver			A point to Phy dirver structure
+**/
+VOID
+EFIAPI
+PhyStopLinkBringUp (
+  IN  PHY_DRIVER   *PhyDriver
+  )
+{
+  if (PhyDriver->LinkTimer != NULL) {
+    gBS->CloseEvent (PhyDriver->LinkTimer);
+    PhyDriver->LinkTimer = NULL;
+  }
+
+  if (PhyDriver->LinkState < PhyLinkStateLinkUp) {
+    PhyLinkEnterState (PhyDriver, PhyLinkStateIdle);
+  }
+}
+
+/**
+	Query the link bring-up state.
+
+	@param PhyDriver			A point to Phy dirver structure
+
+	@retval The current link bring-up state.
+**/
+PHY_LINK_STATE
+EFIAPI
+PhyGetLinkState (
+  IN  PHY_DRIVER   *PhyDriver
+  )
+{
+  return PhyDriver->LinkState;
+}
+
+/**
+	Check whether the link bring-up state machine still owns the PHY.
+
+	@param PhyDriver			A point to Phy dirver structure
+**/
+STATIC
+BOOLEAN
+PhyLinkBringUpPending (
+  IN PHY_DRIVER   *PhyDriver
+  )
+{
+  return (BOOLEAN)(PhyDriver->LinkState > PhyLinkStateIdle &&
+                   PhyDriver->LinkState < PhyLinkStateLinkUp);
+}
+
+/**
+	Perform PHY software reset.
+
+	@param PhyDriver			  A point to Phy dirver structure
+	@param MacBaseAddress 	 	  GMAC register base address
+
+	@retval EFI_SUCCESS		  	  Success to soft reset phy.
+	@retval EFI_TIMEOUT	  		  timeout to soft reset phy.
+**/
+EFI_STATUS
+EFIAPI
+PhySoftReset (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
+
+  Status = PhyResetStart (PhyDriver, MacBaseAddress);
+  if (Status == EFI_UNSUPPORTED) {
+    return EFI_SUCCESS;
+  }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Wait for completion
+  Status = PhyPollRegister (PhyDriver, PHY_BASIC_CTRL, PHYCTRL_RESET, 0, PHY_RESET_TIMEOUT_US, MacBaseAddress);
+  if (Status == EFI_TIMEOUT) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: ERROR! PhySoftReset timeout\n"));
+  }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return EFI_SUCCESS;
+}
+
+
+/**
+	Read the phy devices ID.
+
+	@param PhyAddr			    The phy address
+	@param PhyId			    (PHY_ID1 << 16) | PHY_ID2, optional
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS			Success to read phy ID.
+**/
+EFI_STATUS
+EFIAPI
+PhyReadId (
+  IN UINT32   PhyAddr,
+  OUT UINT32  *PhyId OPTIONAL,
+  IN UINTN    MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        PhyId1;
+  UINT32        PhyId2;
+
+  Status = PhyRead (PhyAddr, PHY_ID1, &PhyId1, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+      return Status;
+  }
+  // An empty address reads back all ones, skip ID2
+  if (PhyId1 == PHY_INVALID_ID) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = PhyRead (PhyAddr, PHY_ID2, &PhyId2, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+      return Status;
+  }
+
+  // ID1 alone may be 0 (e.g. Motorcomm OUI), an address reading all zeroes is empty
+  if (PhyId2 == PHY_INVALID_ID || (PhyId1 == 0 && PhyId2 == 0)) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (PhyId != NULL) {
+    *PhyId = (PhyId1 << 16) | PhyId2;
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: Ethernet PHY detected. PHY_ID1=0x%04X, PHY_ID2=0x%04X, PHY_ADDR=0x%02X\r\n",
+          PhyId1, PhyId2, PhyAddr));
+  return EFI_SUCCESS;
+}
+
+//
+// RTL8211F: LED and EEE LED control
+//
+STATIC CONST PHY_SCRIPT_OP  mRtl8211fConfigScript[] = {
+  PHY_SCRIPT_PAGE (LCR_PAGE),
+  PHY_SCRIPT_WRITE (LCR_REG, 0xC102),
+  PHY_SCRIPT_WRITE (EEELCR_REG, 0x0000),
+};
+
+/**
+	Read RTL8211F link, speed and duplex from PHYSR in one MDIO read.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Link					LINK_UP or LINK_DOWN
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyRtl8211fReadStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Data32;
+
+  Status = PhyPagedRead (PhyDriver, RTL8211F_PHYSR_PAGE, RTL8211F_PHYSR_REG, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Link = (Data32 & RTL8211F_PHYSR_LINK) ? LINK_UP : LINK_DOWN;
+  *Duplex = (Data32 & RTL8211F_PHYSR_DUPLEX) ? DUPLEX_FULL : DUPLEX_HALF;
+  switch (Data32 & RTL8211F_PHYSR_SPEED_MASK) {
+    case RTL8211F_PHYSR_SPEED_1000:
+      *Speed = SPEED_1000;
+      break;
+    case RTL8211F_PHYSR_SPEED_100:
+      *Speed = SPEED_100;
+      break;
+    default:
+      *Speed = SPEED_10;
+      break;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Enable RTL8211F link change and AN complete interrupts (INER).
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Write success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyRtl8211fEnableInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  return PhyPagedWrite (PhyDriver, RTL8211F_INER_PAGE, RTL8211F_INER_REG,
+           RTL8211F_INT_LINK_CHG | RTL8211F_INT_AUTO_COMP, MacBaseAddress);
+}
+
+/**
+	Read and clear RTL8211F interrupt status (INSR).
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Events				Latched link events
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyRtl8211fReadInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Events,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+
+  // INSR is read on the default page, which is normally selected, or on its own page
+  if (PhyDriver->CurrentPage != RTL8211F_DEFAULT_PAGE && PhyDriver->CurrentPage != RTL8211F_INSR_PAGE) {
+    Status = PhySelectPage (PhyDriver, RTL8211F_DEFAULT_PAGE, MacBaseAddress);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Status = PhyRead (PhyDriver->PhyAddr, RTL8211F_INSR_REG, Events, MacBaseAddress);
+  *Events &= RTL8211F_INT_LINK_CHG | RTL8211F_INT_AUTO_COMP;
+  return Status;
+}
+
+//
+// AR8035: debug reg 0x0B bit15 set 0, close hibernate
+//
+STATIC CONST PHY_SCRIPT_OP  mAr8035ConfigScript[] = {
+  PHY_SCRIPT_WRITE (AR8035_DEBUG_ADDR_REG, AR8035_DEBUG_HIB_CTRL),
+  PHY_SCRIPT_MODIFY (AR8035_DEBUG_DATA_REG, AR8035_DEBUG_HIB_EN, 0),
+};
+
+/**
+	Read AR8035 link, speed and duplex from the specific status register in one MDIO read.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Link					LINK_UP or LINK_DOWN
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyAr8035ReadStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Data32;
+
+  Status = PhyRead (PhyDriver->PhyAddr, AR8035_SPECIFIC_STATUS_REG, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Speed and duplex are only meaningful once resolved
+  *Link = ((Data32 & AR8035_SS_LINK) && (Data32 & AR8035_SS_RESOLVED)) ? LINK_UP : LINK_DOWN;
+  *Duplex = (Data32 & AR8035_SS_DUPLEX) ? DUPLEX_FULL : DUPLEX_HALF;
+  switch (Data32 & AR8035_SS_SPEED_MASK) {
+    case AR8035_SS_SPEED_1000:
+      *Speed = SPEED_1000;
+      break;
+    case AR8035_SS_SPEED_100:
+      *Speed = SPEED_100;
+      break;
+    default:
+      *Speed = SPEED_10;
+      break;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Enable AR8035 link up and link down interrupts.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Write success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyAr8035EnableInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  return PhyWrite (PhyDriver->PhyAddr, AR8035_INT_ENABLE_REG,
+           AR8035_INT_LINK_UP | AR8035_INT_LINK_DOWN, MacBaseAddress);
+}
+
+/**
+	Read and clear AR8035 interrupt status.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Events				Latched link events
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyAr8035ReadInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Events,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = PhyRead (PhyDriver->PhyAddr, AR8035_INT_STATUS_REG, Events, MacBaseAddress);
+  *Events &= AR8035_INT_LINK_UP | AR8035_INT_LINK_DOWN;
+  return Status;
+}
+
+//
+// KSZ9031: RGMII pad skew
+//
+STATIC CONST PHY_SCRIPT_OP  mKsz9031SkewScript[] = {
+  PHY_SCRIPT_MMD_WRITE (PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG, PHY_KSZ9031RN_CONTROL_PAD_SKEW_VALUE),
+  PHY_SCRIPT_MMD_WRITE (PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CLK_PAD_SKEW_REG, PHY_KSZ9031RN_CLK_PAD_SKEW_VALUE),
+  PHY_SCRIPT_MMD_WRITE (PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_RX_DATA_PAD_SKEW_REG, PHY_KSZ9031RN_RX_DATA_PAD_SKEW_VALUE),
+  PHY_SCRIPT_MMD_WRITE (PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_TX_DATA_PAD_SKEW_REG, PHY_KSZ9031RN_TX_DATA_PAD_SKEW_VALUE),
+};
+
+//
+// KSZ9031: AN FLP burst transmit timing, 16ms
+//
+STATIC CONST PHY_SCRIPT_OP  mKsz9031FlpScript[] = {
+  PHY_SCRIPT_MMD_WRITE (PHY_KSZ9031RN_MMD_DEV_ADDR_00, PHY_KSZ9031RN_MMD_D0_FLP_LO_REG, PHY_KSZ9031RN_MMD_D0_FLP_16MS_LO),
+  PHY_SCRIPT_MMD_WRITE (PHY_KSZ9031RN_MMD_DEV_ADDR_00, PHY_KSZ9031RN_MMD_D0_FLP_HI_REG, PHY_KSZ9031RN_MMD_D0_FLP_16MS_HI),
+};
+
+/**
+	Config KSZ9031, RGMII pad skew and AN FLP burst timing.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Success to config phy.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyKsz9031Config (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  //
+  // Configure TX/RX Skew
+  //
+  PhyConfigSkew (PhyDriver, MacBaseAddress);
+  //
+  // Read back and display Skew settings
+  //
+  PhyDisplayConfigSkew (PhyDriver, MacBaseAddress);
+  //
+  // Configure AN FLP Burst Trasmit timing interval
+  //
+  PhyConfigFlpBurstTiming (PhyDriver, MacBaseAddress);
+  PhyDisplayFlpBurstTiming (PhyDriver, MacBaseAddress);
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Check the KSZ9031 RGMII pad skew and AN FLP burst timing are in effect.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval TRUE			    The configuration is in effect.
+**/
+STATIC
+BOOLEAN
+EFIAPI
+PhyKsz9031CheckConfig (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  return (BOOLEAN)(PhyCheckScript (PhyDriver, mKsz9031SkewScript, ARRAY_SIZE (mKsz9031SkewScript), MacBaseAddress) &&
+                   PhyCheckScript (PhyDriver, mKsz9031FlpScript, ARRAY_SIZE (mKsz9031FlpScript), MacBaseAddress));
+}
+
+/**
+	Read KSZ9031 link from PHY_BASIC_STATUS, speed and duplex from the PHY control register.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Link					LINK_UP or LINK_DOWN
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyKsz9031ReadStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Data32;
+
+  Status = PhyMdioPollRead (PhyDriver, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if ((Data32 & PHYSTS_LINK_STS) == 0 || (Data32 & PHYSTS_AUTO_COMP) == 0) {
+    *Link = LINK_DOWN;
+    return EFI_SUCCESS;
+  }
+
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_KSZ9031RN_PHY_CTRL_REG, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Link = LINK_UP;
+  *Duplex = (Data32 & PHY_KSZ9031RN_PHY_CTRL_DUPLEX) ? DUPLEX_FULL : DUPLEX_HALF;
+  if (Data32 & PHY_KSZ9031RN_PHY_CTRL_SPEED_1000) {
+    *Speed = SPEED_1000;
+  } else if (Data32 & PHY_KSZ9031RN_PHY_CTRL_SPEED_100) {
+    *Speed = SPEED_100;
+  } else {
+    *Speed = SPEED_10;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Enable KSZ9031 link up and link down interrupts.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Write success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyKsz9031EnableInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  return PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_INT_CTRL_REG,
+           (PHY_KSZ9031RN_INT_LINK_UP | PHY_KSZ9031RN_INT_LINK_DOWN) << PHY_KSZ9031RN_INT_ENABLE_SHIFT,
+           MacBaseAddress);
+}
+
+/**
+	Read and clear KSZ9031 interrupt status.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Events				Latched link events
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyKsz9031ReadInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Events,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_KSZ9031RN_INT_CTRL_REG, Events, MacBaseAddress);
+  *Events &= PHY_KSZ9031RN_INT_LINK_UP | PHY_KSZ9031RN_INT_LINK_DOWN;
+  return Status;
+}
+
+/**
+	Read LAN87xx link from PHY_BASIC_STATUS, speed and duplex from the special status register.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Link					LINK_UP or LINK_DOWN
+	@param Speed				ethernet speed,10M/100M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyLan87xxReadStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Data32;
+
+  Status = PhyMdioPollRead (PhyDriver, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if ((Data32 & PHYSTS_LINK_STS) == 0) {
+    *Link = LINK_DOWN;
+    return EFI_SUCCESS;
+  }
+
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_SPECIAL_PHY_CTLR, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Link = (Data32 & PHYSSCS_AUTODONE) ? LINK_UP : LINK_DOWN;
+  switch (Data32 & PHYSSCS_HCDSPEED_MASK) {
+    case PHYSSCS_HCDSPEED_100FD:
+      *Speed = SPEED_100;
+      *Duplex = DUPLEX_FULL;
+      break;
+    case PHYSSCS_HCDSPEED_100HD:
+      *Speed = SPEED_100;
+      *Duplex = DUPLEX_HALF;
+      break;
+    case PHYSSCS_HCDSPEED_10FD:
+      *Speed = SPEED_10;
+      *Duplex = DUPLEX_FULL;
+      break;
+    default:
+      *Speed = SPEED_10;
+      *Duplex = DUPLEX_HALF;
+      break;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Read link from PHY_BASIC_STATUS, speed and duplex from the IEEE ability registers.
+	The ability registers are only read when the link came up.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Link					LINK_UP or LINK_DOWN
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyGenericReadStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Data32;
+
+  Status = PhyMdioPollRead (PhyDriver, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if ((Data32 & PHYSTS_LINK_STS) == 0 || (Data32 & PHYSTS_AUTO_COMP) == 0) {
+    PhyDriver->ResolvedValid = FALSE;
+    *Link = LINK_DOWN;
+    return EFI_SUCCESS;
+  }
+
+  // The link status is latched low, so an unbroken link kept the resolved speed
+  *Link = LINK_UP;
+  if (!PhyDriver->ResolvedValid) {
+    Status = PhyReadCapability (PhyDriver, &PhyDriver->ResolvedSpeed, &PhyDriver->ResolvedDuplex, MacBaseAddress);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    PhyDriver->ResolvedValid = TRUE;
+  }
+  *Speed = PhyDriver->ResolvedSpeed;
+  *Duplex = PhyDriver->ResolvedDuplex;
+  return EFI_SUCCESS;
+}
+
+/**
+	Enable the PHY_INT_MASK link down and AN complete interrupts.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Write success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyGenericEnableInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  return PhyWrite (PhyDriver->PhyAddr, PHY_INT_MASK, PHYINT_LINK_DOWN | PHYINT_AUTO_COMP, MacBaseAddress);
+}
+
+/**
+	Read and clear PHY_INT_SRC.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Events				Latched link events
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PhyGenericReadInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Events,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_INT_SRC, Events, MacBaseAddress);
+  *Events &= PHYINT_LINK_DOWN | PHYINT_AUTO_COMP;
+  return Status;
+}
+
+STATIC CONST PHY_OPS  mPhyOps[] = {
+  {
+    PHY_ID_RTL8211F, PHY_ID_MASK_EXACT, "RTL8211F",
+    mRtl8211fConfigScript, ARRAY_SIZE (mRtl8211fConfigScript), NULL, NULL,
+    PhyRtl8211fReadStatus, PhyRtl8211fEnableInterrupt, PhyRtl8211fReadInterrupt
+  },
+  {
+    PHY_ID_AR8035, PHY_ID_MASK_NO_REV, "AR8035",
+    mAr8035ConfigScript, ARRAY_SIZE (mAr8035ConfigScript), NULL, NULL,
+    PhyAr8035ReadStatus, PhyAr8035EnableInterrupt, PhyAr8035ReadInterrupt
+  },
+  {
+    PHY_ID_KSZ9031, PHY_ID_MASK_NO_REV, "KSZ9031",
+    NULL, 0, PhyKsz9031Config, PhyKsz9031CheckConfig,
+    PhyKsz9031ReadStatus, PhyKsz9031EnableInterrupt, PhyKsz9031ReadInterrupt
+  },
+  {
+    PHY_ID_LAN8720, PHY_ID_MASK_NO_REV, "LAN8720",
+    NULL, 0, NULL, NULL,
+    PhyLan87xxReadStatus, PhyGenericEnableInterrupt, PhyGenericReadInterrupt
+  },
+  {
+    PHY_ID_LAN8742, PHY_ID_MASK_NO_REV, "LAN8742",
+    NULL, 0, NULL, NULL,
+    PhyLan87xxReadStatus, PhyGenericEnableInterrupt, PhyGenericReadInterrupt
+  },
+};
+
+STATIC CONST PHY_OPS  mPhyGenericOps = {
+  0, 0, "Generic",
+  NULL, 0, NULL, NULL,
+  PhyGenericReadStatus, PhyGenericEnableInterrupt, PhyGenericReadInterrupt
+};
+
+/**
+	Find the operations of a PHY by its ID.
+
+	@param PhyId				(PHY_ID1 << 16) | PHY_ID2
+
+	@retval The PHY operations, the generic IEEE operations for an unknown PHY.
+**/
+CONST PHY_OPS *
+EFIAPI
+PhyFindOps (
+  IN  UINT32       PhyId
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < ARRAY_SIZE (mPhyOps); Index++) {
+    if ((PhyId & mPhyOps[Index].PhyIdMask) == mPhyOps[Index].PhyId) {
+      return &mPhyOps[Index];
+    }
+  }
+
+  return &mPhyGenericOps;
+}
+
+/**
+	Read the link state and the resolved speed and duplex of the PHY.
+	A forced link mode never completes auto-negotiation, the link is up on
+	PHYSTS_LINK_STS alone and runs the speed and duplex of the mode.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Link					LINK_UP or LINK_DOWN
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    Read success
+**/
+EFI_STATUS
+EFIAPI
+PhyReadStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  CONST PHY_OPS                *Ops;
+  CONST PHY_LINK_MODE_SETTING  *Setting;
+  EFI_STATUS                   Status;
+  UINT32                       Data32;
+
+  Ops = (PhyDriver->Ops != NULL) ? PhyDriver->Ops : &mPhyGenericOps;
+
+  *Link = LINK_DOWN;
+  *Speed = SPEED_10;
+  *Duplex = DUPLEX_HALF;
+
+  Setting = PhyLinkModeSetting (PhyDriver);
+  if ((Setting->Control & PHYCTRL_AUTO_EN) == 0) {
+    Status = PhyMdioPollRead (PhyDriver, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    if ((Data32 & PHYSTS_LINK_STS) != 0) {
+      *Link = LINK_UP;
+      *Speed = Setting->Speed;
+      *Duplex = Setting->Duplex;
+    }
+    return EFI_SUCCESS;
+  }
+
+  return Ops->ReadStatus (PhyDriver, Link, Speed, Duplex, MacBaseAddress);
+}
+
+/**
+	Config Phy Skew function.
+
+	@param PhyDriver		  A point to Phy dirver structure
+	@param MacBaseAddress 	  GMAC register base address
+**/
+VOID
+EFIAPI
+PhyConfigSkew (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  PhyRunScript (PhyDriver, "KSZ9031 skew", mKsz9031SkewScript, ARRAY_SIZE (mKsz9031SkewScript),
+    MacBaseAddress, NULL);
+}
+
+/**
+	Read Phy Skew function configuration.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param MacBaseAddress 	GMAC register base address
+**/
+VOID
+EFIAPI
+PhyDisplayConfigSkew (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  UINT16    Skew[PHY_KSZ9031RN_TX_DATA_PAD_SKEW_REG - PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG + 1];
+  UINT32    ClkSkew;
+
+  // Display skew configuration, control/RX/TX skew are adjacent and read as one block
+  DEBUG_CODE_BEGIN ();
+  if (EFI_ERROR (PhyMmdReadBlock (PhyDriver, PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG,
+                   ARRAY_SIZE (Skew), Skew, MacBaseAddress)) ||
+      EFI_ERROR (PhyMmdRead (PhyDriver, PHY_KSZ9031RN_DEV_ADDR, PHY_KSZ9031RN_CLK_PAD_SKEW_REG,
+                   &ClkSkew, MacBaseAddress))) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Fail to read pad skew\r\n"));
+    return;
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: Control Signal Pad Skew = 0x%04X\r\n",
+          Skew[PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG - PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG]));
+  DEBUG ((DEBUG_INFO, "SNP:PHY: RGMII Clock Pad Skew    = 0x%04X\r\n", ClkSkew));
+  DEBUG ((DEBUG_INFO, "SNP:PHY: RGMII RX Data Pad Skew  = 0x%04X\r\n",
+          Skew[PHY_KSZ9031RN_RX_DATA_PAD_SKEW_REG - PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG]));
+  DEBUG ((DEBUG_INFO, "SNP:PHY: RGMII TX Data Pad Skew  = 0x%04X\r\n",
+          Skew[PHY_KSZ9031RN_TX_DATA_PAD_SKEW_REG - PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG]));
+  DEBUG_CODE_END ();
+}
+
+/**
+	Config Phy AN FLP Burst Transmit.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param MacBaseAddress 	GMAC register base address
+**/
+VOID
+EFIAPI
+PhyConfigFlpBurstTiming (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  PhyRunScript (PhyDriver, "KSZ9031 FLP", mKsz9031FlpScript, ARRAY_SIZE (mKsz9031FlpScript),
+    MacBaseAddress, NULL);
+}
+
+/**
+	Read Phy AN FLP Burst Transmit configuration.
+
+	@param PhyDriver	    A point to Phy dirver structure
+	@param MacBaseAddress   GMAC register base address
+**/
+VOID
+EFIAPI
+PhyDisplayFlpBurstTiming (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  UINT16    Flp[PHY_KSZ9031RN_MMD_D0_FLP_HI_REG - PHY_KSZ9031RN_MMD_D0_FLP_LO_REG + 1];
+
+  // Display Auto-Negotiation FLP burst transmit timing
+  DEBUG_CODE_BEGIN ();
+  if (EFI_ERROR (PhyMmdReadBlock (PhyDriver, PHY_KSZ9031RN_MMD_DEV_ADDR_00, PHY_KSZ9031RN_MMD_D0_FLP_LO_REG,
+                   ARRAY_SIZE (Flp), Flp, MacBaseAddress))) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Fail to read AN FLP Burst Transmit timing\r\n"));
+    return;
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: AN FLP Burst Transmit - LO = 0x%04X\r\n", Flp[0]));
+  DEBUG ((DEBUG_INFO, "SNP:PHY: AN FLP Burst Transmit - HI = 0x%04X\r\n", Flp[1]));
+  DEBUG_CODE_END ();
+}
+
+//
+// Advertisement and control of each PHY_LINK_MODE_xxx
+//
+STATIC CONST PHY_LINK_MODE_SETTING  mPhyLinkModes[PHY_LINK_MODE_MAX] = {
+  { PHY_ADVERTISE_10_100, PHY_ADVERTISE_1000, PHYCTRL_AUTO_EN, 0, 0 },
+  { 0, PHYADVERTISE_1000FULL, PHYCTRL_AUTO_EN, 0, 0 },
+  { PHYANA_10BASETFD | PHYANA_100BASETXFD, PHYADVERTISE_1000FULL, PHYCTRL_AUTO_EN, 0, 0 },
+  { 0, 0, PHYCTRL_SPEED_SEL | PHYCTRL_DUPLEX_MODE, SPEED_100, DUPLEX_FULL },
+  { 0, 0, PHYCTRL_SPEED_SEL, SPEED_100, DUPLEX_HALF },
+  { 0, 0, PHYCTRL_DUPLEX_MODE, SPEED_10, DUPLEX_FULL },
+  { 0, 0, 0, SPEED_10, DUPLEX_HALF }
+};
+
+/**
+	Get the advertisement and control of the link mode of a phy.
+
+	@param PhyDriver			A point to Phy dirver structure
+
+	@retval 				    The setting of PhyDriver->LinkMode
+**/
+STATIC
+CONST PHY_LINK_MODE_SETTING *
+PhyLinkModeSetting (
+  IN PHY_DRIVER   *PhyDriver
+  )
+{
+  if (PhyDriver->LinkMode >= PHY_LINK_MODE_MAX) {
+    return &mPhyLinkModes[PHY_LINK_MODE_AUTO];
+  }
+  return &mPhyLinkModes[PhyDriver->LinkMode];
+}
+
+/**
+	Check the PHY control and advertisement follow the link mode. The speed
+	and duplex of PHY_BASIC_CTRL only matter with auto-negotiation disabled.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Control				PHY_BASIC_CTRL
+	@param Advertise			PHY_AUTO_NEG_ADVERT
+	@param GigControl			PHY_1000BASE_T_CONTROL
+
+	@retval TRUE			    The PHY runs the link mode.
+**/
+STATIC
+BOOLEAN
+PhyLinkModeProgrammed (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Control,
+  IN UINT32       Advertise,
+  IN UINT32       GigControl
+  )
+{
+  CONST PHY_LINK_MODE_SETTING  *Setting;
+
+  Setting = PhyLinkModeSetting (PhyDriver);
+  if ((Setting->Control & PHYCTRL_AUTO_EN) == 0) {
+    return (BOOLEAN)((Control & PHY_LINK_MODE_CTRL_MASK) == Setting->Control);
+  }
+
+  return (BOOLEAN)((Control & PHYCTRL_AUTO_EN) != 0 &&
+                   (Advertise & (PHY_ADVERTISE_10_100 | PHYANA_PAUSE_OP_MASK)) == (Setting->Advertise | PHY_PAUSE_ADVERTISE) &&
+                   (GigControl & PHY_ADVERTISE_1000) == Setting->GigControl);
+}
+
+/**
+	Do phy auto-negotiation.
+	A forced link mode only programs the speed and duplex of PHY_BASIC_CTRL.
+	1.Read PHY Status
+	2.Read PHY Auto-Nego Advertise capabilities register for 10/100 Base-T
+	3.Set Advertise capabilities of the link mode for 10Base-T/10Base-T full-duplex/100Base-T/100Base-T full-duplex
+	4.Set Advertise capabilities of the link mode for 1000 Base-T/1000 Base-T full-duplex
+	5.Enable and restart Auto-Negotiation.
+
+	@param PhyDriver	    A point to Phy dirver structure
+	@param MacBaseAddress   GMAC register base address
+
+	@retval EFI_SUCCESS		auto-negotiation config success.
+	@retval EFI_DEVICE_ERROR	Auto-negotiation is not supported
+**/
+EFI_STATUS
+EFIAPI
+PhyAutoNego (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        PhyControl;
+  UINT32        PhyStatus;
+  UINT32        Features;
+  UINT32        Wanted;
+  BOOLEAN       Changed;
+  BOOLEAN       EeeChanged;
+  CONST PHY_LINK_MODE_SETTING  *Setting;
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
+
+  Changed = FALSE;
+  Setting = PhyLinkModeSetting (PhyDriver);
+
+  // Forced link, auto-negotiation disabled
+  if ((Setting->Control & PHYCTRL_AUTO_EN) == 0) {
+    Status = PhyShadowRead (PhyDriver, PHY_BASIC_CTRL, &PhyControl, MacBaseAddress);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    if ((PhyControl & PHY_LINK_MODE_CTRL_MASK) != Setting->Control) {
+      PhyShadowWrite (PhyDriver, PHY_BASIC_CTRL, (PhyControl & ~PHY_LINK_MODE_CTRL_MASK) | Setting->Control, MacBaseAddress);
+    }
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Link forced to %dM %a duplex\r\n",
+            Setting->Speed, Setting->Duplex == DUPLEX_FULL ? "full" : "half"));
+    return EFI_SUCCESS;
+  }
+
+  // Read PHY Status
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &PhyStatus, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Check PHY Status if auto-negotiation is supported
+  if ((PhyStatus & PHYSTS_AUTO_CAP) == 0) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Auto-negotiation is not supported.\n"));
+    return EFI_DEVICE_ERROR;
+  }
+
+  // Read PHY Auto-Nego Advertise capabilities register for 10/100 Base-T
+  Status = PhyShadowRead (PhyDriver, PHY_AUTO_NEG_ADVERT, &Features, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Set Advertise capabilities of the link mode for 10Base-T/10Base-T full-duplex/100Base-T/
+  // 100Base-T full-duplex, and the PAUSE capabilities
+  Wanted = Setting->Advertise | PHY_PAUSE_ADVERTISE;
+  if ((Features & (PHY_ADVERTISE_10_100 | PHYANA_PAUSE_OP_MASK)) != Wanted) {
+    Features = (Features & ~(PHY_ADVERTISE_10_100 | PHYANA_PAUSE_OP_MASK)) | Wanted;
+    PhyShadowWrite (PhyDriver, PHY_AUTO_NEG_ADVERT, Features, MacBaseAddress);
+    Changed = TRUE;
+  }
+
+  // Read PHY Auto-Nego Advertise capabilities register for 1000 Base-T
+  Status = PhyShadowRead (PhyDriver, PHY_1000BASE_T_CONTROL, &Features, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Set Advertise capabilities of the link mode for 1000 Base-T/1000 Base-T full-duplex
+  if ((Features & PHY_ADVERTISE_1000) != Setting->GigControl) {
+    PhyShadowWrite (PhyDriver, PHY_1000BASE_T_CONTROL, (Features & ~PHY_ADVERTISE_1000) | Setting->GigControl, MacBaseAddress);
+    Changed = TRUE;
+  }
+
+  // EEE advertisement of the policy
+  Status = PhyEeeAdvertise (PhyDriver, &EeeChanged, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (EeeChanged) {
+    Changed = TRUE;
+  }
+
+  // Read control register
+  Status = PhyShadowRead (PhyDriver, PHY_BASIC_CTRL, &PhyControl, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Auto-negotiation already runs with this advertisement since the reset
+  if (!Changed && (PhyControl & PHYCTRL_AUTO_EN) != 0) {
+    return EFI_SUCCESS;
+  }
+
+  // Enable Auto-Negotiation
+  PhyControl |= PHYCTRL_AUTO_EN;
+  // Restart auto-negotiation
+  PhyControl |= PHYCTRL_RST_AUTO;
+  // Write this configuration
+  PhyShadowWrite (PhyDriver, PHY_BASIC_CTRL, PhyControl, MacBaseAddress);
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Enable the PHY link-change and auto-negotiation complete interrupts and
+	clear any event latched so far. The PHY interrupt status is then checked
+	before PHY_BASIC_STATUS is sampled, see PhySampleLink.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param MacBaseAddress   GMAC register base address
+
+	@retval EFI_SUCCESS		The interrupts are enabled.
+	@retval EFI_UNSUPPORTED	Link interrupts are disabled by PHY_LINK_IRQ_MODE.
+**/
+EFI_STATUS
+EFIAPI
+PhyEnableLinkInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        Events;
+
+  if (PhyDriver->IrqMode == PHY_LINK_IRQ_NONE) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (PhyDriver->Ops == NULL || PhyDriver->Ops->EnableInterrupt == NULL) {
+    PhyDriver->IrqMode = PHY_LINK_IRQ_NONE;
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = PhyDriver->Ops->EnableInterrupt (PhyDriver, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    PhyDriver->IrqMode = PHY_LINK_IRQ_NONE;
+    return Status;
+  }
+
+  PhyDriver->IrqPending = FALSE;
+  return PhyReadLinkInterrupt (PhyDriver, &Events, MacBaseAddress);
+}
+
+/**
+	Read and clear the latched PHY link interrupt status.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Events			Latched link events, zero if nothing changed
+	@param MacBaseAddress   GMAC register base address
+
+	@retval EFI_SUCCESS		Read success
+**/
+EFI_STATUS
+EFIAPI
+PhyReadLinkInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Events,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        Data32;
+
+  *Events = 0;
+
+  if (PhyDriver->Ops == NULL || PhyDriver->Ops->ReadInterrupt == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = PhyDriver->Ops->ReadInterrupt (PhyDriver, &Data32, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Events = Data32;
+  return EFI_SUCCESS;
+}
+
+/**
+	Signal a PHY interrupt in PHY_LINK_IRQ_GPIO mode.
+	Called by the platform from its PHY interrupt GPIO event, it only marks the
+	link state as stale so the next PhySampleLink reads the PHY.
+
+	@param PhyDriver		A point to Phy dirver structure
+**/
+VOID
+EFIAPI
+PhySignalLinkInterrupt (
+  IN  PHY_DRIVER   *PhyDriver
+  )
+{
+  PhyDriver->IrqPending = TRUE;
+}
+
+/**
+	EEE speeds to advertise under PHY_EEE_POLICY.
+
+	@param Capability			PHY_EEE_xxx speeds of the PHY
+
+	@retval The PHY_EEE_xxx speeds to advertise.
+**/
+STATIC
+UINT32
+PhyEeePolicyAdvertisement (
+  IN UINT32       Capability
+  )
+{
+  UINT32    Advertise;
+
+  switch (PHY_EEE_POLICY) {
+    case PHY_EEE_ON:
+      return Capability;
+
+    case PHY_EEE_LATENCY:
+      Advertise = 0;
+      if (PHY_EEE_WAKE_1000_US <= PHY_EEE_MAX_WAKE_US) {
+        Advertise |= PHY_EEE_1000BASET;
+      }
+      if (PHY_EEE_WAKE_100_US <= PHY_EEE_MAX_WAKE_US) {
+        Advertise |= PHY_EEE_100BASETX;
+      }
+      return Capability & Advertise;
+
+    default:
+      return 0;
+  }
+}
+
+/**
+	Read the EEE capability of the PHY once per bring-up. PHYs without EEE or
+	without MMD access read 0.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+**/
+STATIC
+VOID
+PhyEeeReadCapability (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  UINT32    Data32;
+
+  PhyDriver->EeeCapability = 0;
+  if (!EFI_ERROR (PhyMmdRead (PhyDriver, PHY_MMD_DEV_PCS, PHY_MMD_PCS_EEE_CAP, &Data32, MacBaseAddress)) &&
+      Data32 != 0xFFFF) {
+    PhyDriver->EeeCapability = (UINT16)(Data32 & PHY_EEE_MASK);
+  }
+}
+
+/**
+	Write the EEE advertisement of PHY_EEE_POLICY, before auto-negotiation is
+	(re)started.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Changed				The advertisement changed, auto-negotiation must restart
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    The PHY advertises the policy, or has no EEE.
+	@retval other			    The advertisement could not be written.
+**/
+STATIC
+EFI_STATUS
+PhyEeeAdvertise (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT BOOLEAN      *Changed,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  UINT32      Advertise;
+  UINT32      Wanted;
+  EFI_STATUS  Status;
+
+  *Changed = FALSE;
+  PhyEeeReadCapability (PhyDriver, MacBaseAddress);
+  if (PhyDriver->EeeCapability == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Status = PhyMmdRead (PhyDriver, PHY_MMD_DEV_AN, PHY_MMD_AN_EEE_ADV, &Advertise, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Wanted = PhyEeePolicyAdvertisement (PhyDriver->EeeCapability);
+  if ((Advertise & PHY_EEE_MASK) == Wanted) {
+    return EFI_SUCCESS;
+  }
+
+  Status = PhyMmdWrite (PhyDriver, PHY_MMD_DEV_AN, PHY_MMD_AN_EEE_ADV, (Advertise & ~PHY_EEE_MASK) | Wanted, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "SNP:PHY: Fail to write the EEE advertisement - %r\r\n", Status));
+    return Status;
+  }
+
+  *Changed = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+	Check the PHY advertises the EEE speeds of PHY_EEE_POLICY.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval TRUE			    The EEE advertisement follows the policy.
+**/
+STATIC
+BOOLEAN
+PhyEeeAdvertised (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  UINT32    Advertise;
+
+  PhyEeeReadCapability (PhyDriver, MacBaseAddress);
+  if (PhyDriver->EeeCapability == 0) {
+    return TRUE;
+  }
+
+  return (BOOLEAN)(!EFI_ERROR (PhyMmdRead (PhyDriver, PHY_MMD_DEV_AN, PHY_MMD_AN_EEE_ADV, &Advertise, MacBaseAddress)) &&
+                   (Advertise & PHY_EEE_MASK) == PhyEeePolicyAdvertisement (PhyDriver->EeeCapability));
+}
+
+/**
+	Resolve EEE on the current link and program the GMAC LPI through EmacConfigLpi.
+	LPI is used only when both sides advertise EEE for the resolved full-duplex
+	speed. The transmit wait timer holds the first frame after LPI exit for the
+	wake time of the speed, so no frame is sent before the link is awake.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Link					LINK_UP or LINK_DOWN
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+**/
+STATIC
+VOID
+PhyEeeResolve (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Link,
+  IN UINT32       Speed,
+  IN UINT32       Duplex,
+  IN UINTN        MacBaseAddress
+  )
+{
+  UINT32    Advertise;
+  UINT32    Partner;
+  UINT32    SpeedBit;
+  UINT32    WakeUs;
+
+  PhyDriver->EeeActive = FALSE;
+  WakeUs = 0;
+
+  // The capability is not known yet when bring-up adopted a running negotiation
+  if (Link == LINK_UP && PhyDriver->EeeCapability == 0) {
+    PhyEeeReadCapability (PhyDriver, MacBaseAddress);
+  }
+
+  if (Link == LINK_UP && PhyDriver->EeeCapability != 0 && Duplex == DUPLEX_FULL &&
+      !EFI_ERROR (PhyMmdRead (PhyDriver, PHY_MMD_DEV_AN, PHY_MMD_AN_EEE_ADV, &Advertise, MacBaseAddress)) &&
+      !EFI_ERROR (PhyMmdRead (PhyDriver, PHY_MMD_DEV_AN, PHY_MMD_AN_EEE_LP_ABILITY, &Partner, MacBaseAddress))) {
+    SpeedBit = 0;
+    if (Speed == SPEED_1000) {
+      SpeedBit = PHY_EEE_1000BASET;
+      WakeUs = PHY_EEE_WAKE_1000_US;
+    } else if (Speed == SPEED_100) {
+      SpeedBit = PHY_EEE_100BASETX;
+      WakeUs = PHY_EEE_WAKE_100_US;
+    }
+    // Only the speeds of PHY_EEE_POLICY count, whatever the PHY advertises
+    Advertise &= PhyEeePolicyAdvertisement (PhyDriver->EeeCapability);
+    PhyDriver->EeeActive = (BOOLEAN)((Advertise & Partner & SpeedBit) != 0);
+    DEBUG ((DEBUG_INFO, "SNP:PHY: EEE %a, advertised 0x%x, link partner 0x%x\r\n",
+            PhyDriver->EeeActive ? "on" : "off", Advertise & PHY_EEE_MASK, Partner & PHY_EEE_MASK));
+  }
+
+  EmacConfigLpi (PhyDriver->EeeActive, PHY_EEE_LS_TIMER_MS, WakeUs, MacBaseAddress);
+}
+
+/**
+	Resolve PAUSE on the current link per IEEE 802.3 Annex 28B. PAUSE applies
+	to full duplex links only.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Duplex				Duplex mode,half/full
+	@param PauseTx				PAUSE frames are sent
+	@param PauseRx				PAUSE frames are honored
+	@param MacBaseAddress 		GMAC register base address
+**/
+STATIC
+VOID
+PhyPauseResolve (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Duplex,
+  OUT BOOLEAN      *PauseTx,
+  OUT BOOLEAN      *PauseRx,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  UINT32    Advertise;
+  UINT32    Partner;
+
+  *PauseTx = FALSE;
+  *PauseRx = FALSE;
+
+  // PAUSE is negotiated, a forced link runs without
+  if (Duplex != DUPLEX_FULL ||
+      (PhyLinkModeSetting (PhyDriver)->Control & PHYCTRL_AUTO_EN) == 0 ||
+      EFI_ERROR (PhyShadowRead (PhyDriver, PHY_AUTO_NEG_ADVERT, &Advertise, MacBaseAddress)) ||
+      EFI_ERROR (PhyRead (PhyDriver->PhyAddr, PHY_AUTO_NEG_LINK_ABILITY, &Partner, MacBaseAddress))) {
+    return;
+  }
+
+  if ((Advertise & PHYANA_PAUSE_CAP) && (Partner & PHYLPA_PAUSE_CAP)) {
+    // Symmetric
+    *PauseTx = TRUE;
+    *PauseRx = TRUE;
+  } else if ((Advertise & PHYANA_PAUSE_ASYM) && (Partner & PHYLPA_PAUSE_ASYM)) {
+    // Asymmetric, towards the side that also advertises symmetric PAUSE
+    if (Advertise & PHYANA_PAUSE_CAP) {
+      *PauseRx = TRUE;
+    } else if (Partner & PHYLPA_PAUSE_CAP) {
+      *PauseTx = TRUE;
+    }
+  }
+  DEBUG ((DEBUG_INFO, "SNP:PHY: PAUSE tx %a rx %a, link partner 0x%x\r\n",
+          *PauseTx ? "on" : "off", *PauseRx ? "on" : "off",
+          Partner & (PHYLPA_PAUSE_CAP | PHYLPA_PAUSE_ASYM)));
+}
+
+/**
+	Program the GMAC for the resolved link: speed and duplex, flow control and LPI.
+	EmacConfigAdjust and the flow control are skipped when the GMAC already runs
+	the resolved speed, duplex and PAUSE, so a link that comes back unchanged
+	does not restart the datapath.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param Duplex				Duplex mode,half/full
+	@param MacBaseAddress 		GMAC register base address
+**/
+STATIC
+VOID
+PhyAdjustMac (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Speed,
+  IN UINT32       Duplex,
+  IN UINTN        MacBaseAddress
+  )
+{
+  BOOLEAN     PauseTx;
+  BOOLEAN     PauseRx;
+  UINT32      Link;
+  EFI_STATUS  Status;
+
+  PhyPauseResolve (PhyDriver, Duplex, &PauseTx, &PauseRx, MacBaseAddress);
+
+  if (PhyDriver->MacConfigValid && PhyDriver->MacSpeed == Speed && PhyDriver->MacDuplex == Duplex &&
+      PhyDriver->PauseTx == PauseTx && PhyDriver->PauseRx == PauseRx) {
+    PhyTrace (PhyTraceMacConfig, PhyDriver->PhyAddr, Speed, MAX_UINT16);
+  } else {
+    PhyTrace (PhyTraceMacConfig, PhyDriver->PhyAddr, Speed, (Duplex << 8) | (PauseRx << 1) | PauseTx);
+    EmacConfigAdjust (Speed, Duplex, MacBaseAddress);
+    EmacConfigFlowControl (PauseTx, PauseRx, MacBaseAddress);
+    PhyDriver->MacSpeed = Speed;
+    PhyDriver->MacDuplex = Duplex;
+    PhyDriver->PauseTx = PauseTx;
+    PhyDriver->PauseRx = PauseRx;
+    PhyDriver->MacConfigValid = TRUE;
+  }
+
+  // Only a link that differs from the saved one costs a variable write
+  Link = PHY_LINK_PACK (Speed, Duplex, PauseTx, PauseRx);
+  if (PHY_LINK_PRECONFIG && Link != PhyDriver->SavedLink) {
+    Status = PhySaveLink (MacBaseAddress, Link);
+    if (!EFI_ERROR (Status)) {
+      PhyDriver->SavedLink = Link;
+    } else {
+      DEBUG ((DEBUG_WARN, "SNP:PHY: Fail to save the link - %r\r\n", Status));
+    }
+  }
+
+  PhyEeeResolve (PhyDriver, LINK_UP, Speed, Duplex, MacBaseAddress);
+}
+
+/**
+	Program the GMAC for the link resolved on the previous boot, before
+	auto-negotiation completes. The EMAC initialization of the Simple Network
+	Protocol may reset the GMAC after this, so the configuration is not marked
+	valid and the first link up always programs the GMAC in PhyAdjustMac.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+**/
+STATIC
+VOID
+PhyPreconfigureMac (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  UINT32    Link;
+
+  if (EFI_ERROR (PhyLoadLink (MacBaseAddress, &Link))) {
+    return;
+  }
+
+  PhyDriver->SavedLink = Link;
+  PhyDriver->MacSpeed = PHY_LINK_SPEED (Link);
+  PhyDriver->MacDuplex = PHY_LINK_DUPLEX (Link);
+  PhyDriver->PauseTx = PHY_LINK_PAUSE_TX (Link);
+  PhyDriver->PauseRx = PHY_LINK_PAUSE_RX (Link);
+  EmacConfigAdjust (PhyDriver->MacSpeed, PhyDriver->MacDuplex, MacBaseAddress);
+  EmacConfigFlowControl (PhyDriver->PauseTx, PhyDriver->PauseRx, MacBaseAddress);
+
+  PhyTrace (PhyTraceMacConfig, PhyDriver->PhyAddr, PhyDriver->MacSpeed,
+    (PhyDriver->MacDuplex << 8) | (PhyDriver->PauseRx << 1) | PhyDriver->PauseTx);
+}
+
+/**
+	Check the quality of an up link, and restart auto-negotiation on a downshift
+	or a burst of 1000BASE-T idle errors while the retrain budget lasts. Every
+	event is reported, so marginal cabling shows up in the log. Once the budget
+	is used up the link is kept as it is and no longer checked.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Speed				ethernet speed,10M/100M/1000M
+	@param CheckIdleErrors		Check the idle errors counted since the last check
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval TRUE			    Auto-negotiation was restarted.
+**/
+STATIC
+BOOLEAN
+PhyCheckLinkQuality (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Speed,
+  IN BOOLEAN      CheckIdleErrors,
+  IN UINTN        MacBaseAddress
+  )
+{
+  UINT32    GigControl;
+  UINT32    GigStatus;
+  UINT32    IdleErrors;
+  UINT32    Control;
+
+  PhyDriver->QualityCheckTime = PhyGetTimeUs ();
+  if (!PHY_QUALITY_MONITOR || PhyDriver->QualityExhausted ||
+      (PhyLinkModeSetting (PhyDriver)->Control & PHYCTRL_AUTO_EN) == 0) {
+    return FALSE;
+  }
+
+  // Idle errors are counted since the previous check
+  if (EFI_ERROR (PhyShadowRead (PhyDriver, PHY_1000BASE_T_CONTROL, &GigControl, MacBaseAddress)) ||
+      EFI_ERROR (PhyReadGigStatus (PhyDriver, &GigStatus, MacBaseAddress))) {
+    return FALSE;
+  }
+  IdleErrors = (UINT32)(PhyDriver->Counters.IdleErrors - PhyDriver->QualityIdleErrors);
+  PhyDriver->QualityIdleErrors = PhyDriver->Counters.IdleErrors;
+
+  if (Speed != SPEED_1000) {
+    if ((GigControl & PHY_ADVERTISE_1000) == 0 || (GigStatus & (PHYLPA_1000FULL | PHYLPA_1000HALF)) == 0) {
+      return FALSE;
+    }
+    DEBUG ((DEBUG_WARN, "SNP:PHY: Link downshifted to %dM, both sides can do 1000M - check the cable\r\n", Speed));
+    PhyTrace (PhyTraceDownshift, PhyDriver->PhyAddr, Speed, GigStatus);
+  } else {
+    if (!CheckIdleErrors || IdleErrors < PHY_QUALITY_IDLE_ERR_BURST) {
+      return FALSE;
+    }
+    DEBUG ((DEBUG_WARN, "SNP:PHY: %d 1000BASE-T idle errors - check the cable\r\n", IdleErrors));
+    PhyTrace (PhyTraceIdleErrors, PhyDriver->PhyAddr, 0, IdleErrors);
+  }
+
+  if (PhyDriver->Retrains >= PHY_QUALITY_RETRAIN_MAX) {
+    DEBUG ((DEBUG_WARN, "SNP:PHY: Retrain budget used up, keep the link\r\n"));
+    PhyDriver->QualityExhausted = TRUE;
+    return FALSE;
+  }
+
+  if (EFI_ERROR (PhyShadowRead (PhyDriver, PHY_BASIC_CTRL, &Control, MacBaseAddress))) {
+    return FALSE;
+  }
+  PhyDriver->Retrains++;
+  PhyTrace (PhyTraceRetrain, PhyDriver->PhyAddr, 0, PhyDriver->Retrains);
+  DEBUG ((DEBUG_WARN, "SNP:PHY: Retrain the link, %d of %d\r\n", PhyDriver->Retrains, PHY_QUALITY_RETRAIN_MAX));
+  PhyShadowWrite (PhyDriver, PHY_BASIC_CTRL, Control | PHYCTRL_AUTO_EN | PHYCTRL_RST_AUTO, MacBaseAddress);
+  return TRUE;
+}
+
+/**
+	Sample the PHY link state, at most once per poll interval.
+	A sample is one PhyReadStatus, which also resolves speed and duplex. On a
+	down to up transition the GMAC is adjusted. The poll interval doubles
+	while the link state is stable and drops back to the minimum after a change.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param MacBaseAddress   GMAC register base address
+
+	@retval EFI_SUCCESS		The link state is current, sampled or not.
+	@retval other			The PHY could not be read.
+**/
+STATIC
+EFI_STATUS
+PhySampleLink (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS   Status;
+  UINT32       LinkStatus;
+  UINT32       Speed;
+  UINT32       Duplex;
+  UINT32       Events;
+  UINT64       Now;
+
+  Now = PhyGetTimeUs ();
+
+  // Fold the hardware counters before they wrap
+  if (Now - PhyDriver->Counters.SampleTime >= PHY_COUNTER_INTERVAL_US) {
+    PhySampleCounters (PhyDriver, MacBaseAddress);
+  }
+
+  // The link goes down after a retrain, sample it at the minimum interval
+  if (PhyDriver->PhyCurrentLink == LINK_UP && !PhyDriver->LinkPending &&
+      Now - PhyDriver->QualityCheckTime >= PHY_QUALITY_INTERVAL_US) {
+    if (PhyCheckLinkQuality (PhyDriver, PhyDriver->MacSpeed, TRUE, MacBaseAddress)) {
+      PhyDriver->PollInterval = PHY_POLL_INTERVAL_MIN_US;
+    }
+  }
+
+  // With the link interrupts armed, only read the PHY once it reported a change,
+  // unless a transition is still settling
+  if (PhyDriver->IrqMode == PHY_LINK_IRQ_GPIO && PhyDriver->PollInterval != PHY_POLL_INTERVAL_MIN_US) {
+    if (!PhyDriver->IrqPending) {
+      return EFI_SUCCESS;
+    }
+    PhyDriver->IrqPending = FALSE;
+  } else if (PhyDriver->PollInterval != 0 &&
+             Now - PhyDriver->LastPollTime < PhyDriver->PollInterval) {
+    return EFI_SUCCESS;
+  }
+  PhyDriver->LastPollTime = Now;
+
+  if (PhyDriver->IrqMode != PHY_LINK_IRQ_NONE && PhyDriver->PollInterval != PHY_POLL_INTERVAL_MIN_US) {
+    Status = PhyReadLinkInterrupt (PhyDriver, &Events, MacBaseAddress);
+    if (!EFI_ERROR (Status) && Events == 0) {
+      PhyDriver->PollInterval = PHY_POLL_INTERVAL_MAX_US;
+      return EFI_SUCCESS;
+    }
+  }
+
+  // One resolved status read gives link, speed and duplex together
+  Status = PhyReadStatus (PhyDriver, &LinkStatus, &Speed, &Duplex, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    PhyDriver->PollInterval = PHY_POLL_INTERVAL_MIN_US;
+    return Status;
+  }
+  PhyTrace (PhyTraceLinkSample, PhyDriver->PhyAddr, (LinkStatus == LINK_UP) ? Speed : 0,
+    (LinkStatus == LINK_UP) ? ((Duplex << 8) | LinkStatus) : LinkStatus);
+
+  if (LinkStatus == PhyDriver->PhyOldLink) {
+    if (PhyDriver->LinkPending) {
+      PhyTrace (PhyTraceLinkFlap, PhyDriver->PhyAddr, 0, PhyDriver->PendingLink);
+      PhyDriver->LinkPending = FALSE;
+    }
+    PhyDriver->PollInterval = MIN (MAX (PhyDriver->PollInterval, PHY_POLL_INTERVAL_MIN_US) * 2,
+                                   PHY_POLL_INTERVAL_MAX_US);
+    return EFI_SUCCESS;
+  }
+
+  // A transition: keep sampling fast while it settles
+  PhyDriver->PollInterval = PHY_POLL_INTERVAL_MIN_US;
+
+  // Report it once it held for the debounce window
+  if (!PhyDriver->LinkPending || PhyDriver->PendingLink != LinkStatus) {
+    PhyDriver->LinkPending = TRUE;
+    PhyDriver->PendingLink = LinkStatus;
+    PhyDriver->PendingSince = Now;
+  }
+  if (Now - PhyDriver->PendingSince < PHY_LINK_DEBOUNCE_US) {
+    return EFI_SUCCESS;
+  }
+  PhyDriver->LinkPending = FALSE;
+  PhyTrace (PhyTraceLinkChange, PhyDriver->PhyAddr, (LinkStatus == LINK_UP) ? Speed : 0,
+    (LinkStatus == LINK_UP) ? ((Duplex << 8) | LinkStatus) : LinkStatus);
+
+  if (LinkStatus == LINK_UP) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Link is up - Network Cable is Plugged\r\n"));
+    PhyDisplayAbility (Speed, Duplex);
+    PhyAdjustMac (PhyDriver, Speed, Duplex, MacBaseAddress);
+    PhyCheckLinkQuality (PhyDriver, Speed, FALSE, MacBaseAddress);
+  } else {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Link is Down - Network Cable is Unplugged?\r\n"));
+    PhyEeeResolve (PhyDriver, LINK_DOWN, 0, DUPLEX_HALF, MacBaseAddress);
+    // The next link up programs the GMAC again, whatever it resolves to
+    PhyDriver->MacConfigValid = FALSE;
+  }
+
+  PhyDriver->PhyCurrentLink = LinkStatus;
+  PhyDriver->PhyOldLink = LinkStatus;
+  return EFI_SUCCESS;
+}
+
+/**
+	Phy link adjust config.
+	Return the last sampled link state, the PHY is sampled and the GMAC is
+	adjusted at most once per poll interval, see PhySampleLink.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param MacBaseAddress   GMAC register base address
+
+	@retval EFI_SUCCESS		phy link up.
+	@retval EFI_NOT_READY	phy link down.
+**/
+EFI_STATUS
+EFIAPI
+PhyLinkAdjustEmacConfig (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  // Bring-up is still running from the timer, report the link as not ready yet
+  if (PhyLinkBringUpPending (PhyDriver)) {
+    return EFI_NOT_READY;
+  }
+
+  PhySampleLink (PhyDriver, MacBaseAddress);
+  if (PhyDriver->PhyCurrentLink != PhyDriver->QueryLink) {
+    PhyTrace (PhyTraceLinkQuery, PhyDriver->PhyAddr, 0, PhyDriver->PhyCurrentLink);
+    PhyDriver->QueryLink = PhyDriver->PhyCurrentLink;
+  }
+  if (PhyDriver->PhyCurrentLink == LINK_DOWN) {
+    return EFI_NOT_READY;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Check phy link status.
+	1.check phy link existed or not.
+	2.wait until Auto Negotiation completed.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param MacBaseAddress   GMAC register base address
+
+	@retval EFI_SUCCESS		phy link up.
+	@retval EFI_TIMEOUT		phy link down.
+**/
+EFI_STATUS
+EFIAPI
+PhyCheckLinkStatus (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        PhyBasicStatus;
+
+  // Get the PHY Status
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &PhyBasicStatus, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // if Link is already up then dont need to proceed anymore
+  if (PhyBasicStatus & PHYSTS_LINK_STS) {
+    return EFI_SUCCESS;
+  }
+
+  // Wait until it is up or until Time Out
+  Status = PhyPollRegister (PhyDriver, PHY_BASIC_STATUS, PHYSTS_LINK_STS, PHYSTS_LINK_STS,
+             PHY_LINK_TIMEOUT_US, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    // Link is down
+    return Status;
+  }
+
+  if ((PhyLinkModeSetting (PhyDriver)->Control & PHYCTRL_AUTO_EN) == 0) {
+    return EFI_SUCCESS;
+  }
+
+  // Wait until autonego process has completed
+  Status = PhyPollRegister (PhyDriver, PHY_BASIC_STATUS, PHYSTS_AUTO_COMP, PHYSTS_AUTO_COMP,
+             PHY_AUTONEGO_TIMEOUT_US, MacBaseAddress);
+  if (Status == EFI_TIMEOUT) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: Error! Auto Negotiation timeout\n"));
+  }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  DEBUG ((DEBUG_INFO, "SNP:PHY: Auto Negotiation completed\r\n"));
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Read phy capability.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param speed			ethernet speed,10M/100M/1000M
+	@param duplex			Duplex mode,half/full
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Read success
+**/
+EFI_STATUS
+EFIAPI
+PhyReadCapability (
+  IN PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  UINT32        PartnerAbilityGb;
+  UINT32        AdvertisingGb;
+  UINT32        CommonAbilityGb;
+  UINT32        PartnerAbility;
+  CONST PHY_LINK_MODE_SETTING  *Setting;
+
+  // A forced link runs at the speed and duplex of the link mode
+  Setting = PhyLinkModeSetting (PhyDriver);
+  if ((Setting->Control & PHYCTRL_AUTO_EN) == 0) {
+    *Speed = Setting->Speed;
+    *Duplex = Setting->Duplex;
+    return EFI_SUCCESS;
+  }
+
+  // For 1000 Base-T
+  Status = PhyReadGigStatus (PhyDriver, &PartnerAbilityGb, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = PhyShadowRead (PhyDriver, PHY_1000BASE_T_CONTROL, &AdvertisingGb, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CommonAbilityGb = PartnerAbilityGb & (AdvertisingGb << 2);
+
+  // For 10/100 Base-T
+
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_AUTO_NEG_LINK_ABILITY, &PartnerAbility, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Determine the Speed and Duplex
+  if (PartnerAbilityGb & (PHYLPA_1000FULL | PHYLPA_1000HALF)) {
+    *Speed = SPEED_1000;
+    if (CommonAbilityGb & PHYLPA_1000FULL) {
+      *Duplex = DUPLEX_FULL;
+    }
+	else{
+		*Duplex = DUPLEX_HALF;
+	}
+  }
+  else {
+  	if (PartnerAbility & (PHYLPA_100FULL | PHYLPA_100HALF)){
+		*Speed = SPEED_100;
+		if (PartnerAbility & PHYLPA_100FULL) {
+		  *Duplex = DUPLEX_FULL;
+		}
+		else{
+		  *Duplex = DUPLEX_HALF;
+		}
+  	}
+	else  {
+      *Speed = SPEED_10;
+	  	if (PartnerAbility & PHYLPA_10FULL) {
 		  *Duplex = DUPLEX_FULL;
 		}
 		else{
@@ -653,151 +3205,1449 @@ PhyReadCapability (
     }
   }
 
-  PhyDisplayAbility (*Speed, *Duplex);
+  return EFI_SUCCESS;
+}
+
+/**
+	Display phy capability.
+
+	@param speed			  ethernet speed,10M/100M/1000M
+	@param duplex 		  	  Duplex mode,half/full
+**/
+VOID
+EFIAPI
+PhyDisplayAbility (
+  IN UINT32   Speed,
+  IN UINT32   Duplex
+  )
+{
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: "));
+  switch (Speed) {
+    case SPEED_1000:
+      DEBUG ((DEBUG_INFO, "1 Gbps - "));
+      break;
+    case SPEED_100:
+      DEBUG ((DEBUG_INFO, "100 Mbps - "));
+      break;
+    case SPEED_10:
+      DEBUG ((DEBUG_INFO, "10 Mbps - "));
+      break;
+    default:
+      DEBUG ((DEBUG_INFO, "Invalid link speed"));
+      break;
+    }
+
+  switch (Duplex) {
+    case DUPLEX_FULL:
+      DEBUG ((DEBUG_INFO, "Full Duplex\n"));
+      break;
+    case DUPLEX_HALF:
+      DEBUG ((DEBUG_INFO, "Half Duplex\n"));
+      break;
+    default:
+      DEBUG ((DEBUG_INFO, "Invalid duplex mode\n"));
+      break;
+    }
+}
+
+//
+// GMII_ADDRESS CSR clock ranges, from the fastest MDC to the slowest
+//
+typedef struct {
+  UINT32   ClockRange;
+  UINT32   Divider;
+} PHY_MDC_DIVIDER;
+
+STATIC CONST PHY_MDC_DIVIDER  mMdcDivider[] = {
+  { MII_CLKRANGE_20_35M,   16  },
+  { MII_CLKRANGE_35_60M,   26  },
+  { MII_CLKRANGE_60_100M,  42  },
+  { MII_CLKRANGE_100_150M, 62  },
+  { MII_CLKRANGE_150_250M, 102 },
+  { MII_CLKRANGE_250_300M, 124 },
+};
+
+STATIC PHY_MDIO_BUS  mMdioBus[PHY_MDIO_BUS_MAX];
+
+//
+// GMAC to MDIO bus mapping
+//
+typedef struct {
+  UINTN          MacBaseAddress;          // 0 for an unused entry
+  PHY_MDIO_BUS   *Bus;
+  UINT32         PhyAddr;                 // PHY of the port, PHY_ADDR_NONE to detect it
+} PHY_MDIO_ATTACH;
+
+STATIC PHY_MDIO_ATTACH  mMdioAttach[PHY_INSTANCE_MAX];
+
+/**
+	Wait for the GMII busy bit to clear, bounded in real time.
+
+	@param MacBaseAddress 	GMAC register base address
+	@param BusyPolls		Number of busy bit reads
+
+	@retval EFI_SUCCESS	    The MDIO frame completed.
+	@retval EFI_TIMEOUT	    The MDIO frame did not complete within PHY_MDIO_TIMEOUT_US.
+**/
+STATIC
+EFI_STATUS
+PhyMdioWaitIdle (
+  IN  UINTN    MacBaseAddress,
+  OUT UINT32   *BusyPolls
+  )
+{
+  UINT64    Start;
+
+  *BusyPolls = 0;
+  Start = PhyGetTimeUs ();
+  do {
+    (*BusyPolls)++;
+    if (!(DW_EMAC_GMACGRP_GMII_ADDRESS_GB_GET (MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST)))) {
+      return EFI_SUCCESS;
+    }
+    MemoryFence ();
+  } while (PhyGetTimeUs () - Start < PHY_MDIO_TIMEOUT_US);
+
+  // The frame may have completed while the deadline was checked
+  (*BusyPolls)++;
+  if (!(DW_EMAC_GMACGRP_GMII_ADDRESS_GB_GET (MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST)))) {
+    return EFI_SUCCESS;
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: MDIO busy bit timeout\r\n"));
+  return EFI_TIMEOUT;
+}
+
+/**
+	Run one MDIO frame with the given CSR clock range.
+
+	@param Addr				Phy device physical address
+	@param Reg 				Phy register
+	@param Write			TRUE for a write frame
+	@param Data				Data to write, or read data
+	@param ClockRange		MII_CLKRANGE_xxx
+	@param MacBaseAddress 	GMAC register base address
+	@param BusyPolls		Number of busy bit reads, optional
+
+	@retval EFI_SUCCESS	    The frame completed.
+	@retval EFI_TIMEOUT	    The frame did not complete.
+**/
+STATIC
+EFI_STATUS
+PhyMdioTransfer (
+  IN     UINT32   Addr,
+  IN     UINT32   Reg,
+  IN     BOOLEAN  Write,
+  IN OUT UINT32   *Data,
+  IN     UINT32   ClockRange,
+  IN     UINTN    MacBaseAddress,
+  OUT    UINT32   *BusyPolls OPTIONAL
+  )
+{
+  UINT32        MiiConfig;
+  UINT32        Polls;
+  EFI_STATUS    Status;
+
+  MiiConfig = ((Addr << MIIADDRSHIFT) & MII_ADDRMSK) |
+              ((Reg << MIIREGSHIFT) & MII_REGMSK)|
+               (ClockRange & MII_CLKRANGE_MASK) |
+               MII_BUSY;
+
+  if (Write) {
+    // Write the desired value to the register first
+    MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_DATA_OFST, (*Data & 0xFFFF));
+    MiiConfig |= MII_WRITE;
+  }
+
+  // write this config to register
+  MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST, MiiConfig);
+
+  Status = PhyMdioWaitIdle (MacBaseAddress, &Polls);
+  if (BusyPolls != NULL) {
+    *BusyPolls = Polls;
+  }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (!Write) {
+    *Data = DW_EMAC_GMACGRP_GMII_DATA_GD_GET (MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_DATA_OFST));
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+	Pick the fastest CSR clock range whose MDC stays within MII_MDC_MAX_HZ.
+
+	@param CsrClockHz		GMAC CSR clock
+
+	@retval The MII_CLKRANGE_xxx value.
+**/
+STATIC
+UINT32
+PhyMdcClockRange (
+  IN UINT32   CsrClockHz
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < ARRAY_SIZE (mMdcDivider); Index++) {
+    if (CsrClockHz / mMdcDivider[Index].Divider <= MII_MDC_MAX_HZ) {
+      return mMdcDivider[Index].ClockRange;
+    }
+  }
+
+  return mMdcDivider[ARRAY_SIZE (mMdcDivider) - 1].ClockRange;
+}
+
+/**
+	Measure the GMAC CSR clock by timing MDIO frames with the slowest MDC divider.
+	A clause 22 frame lasts MII_FRAME_MDC_CYCLES MDC cycles, the polling overhead
+	makes the frames look slightly longer, so the estimate errs on the low side
+	and is padded by 1/8 before a range is picked.
+
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval The CSR clock estimate in Hz, 0 if the frames could not be timed.
+**/
+STATIC
+UINT32
+PhyMdcCalibrate (
+  IN UINTN    MacBaseAddress
+  )
+{
+  CONST PHY_MDC_DIVIDER  *Slowest;
+  UINT64                 Start;
+  UINT64                 Elapsed;
+  UINT64                 CsrClockHz;
+  UINT32                 Data32;
+  UINTN                  Index;
+
+  Slowest = &mMdcDivider[ARRAY_SIZE (mMdcDivider) - 1];
+
+  Start = GetTimeInNanoSecond (GetPerformanceCounter ());
+  for (Index = 0; Index < PHY_MDC_CALIBRATE_FRAMES; Index++) {
+    if (EFI_ERROR (PhyMdioTransfer (0, PHY_ID1, FALSE, &Data32, Slowest->ClockRange, MacBaseAddress, NULL))) {
+      return 0;
+    }
+  }
+  Elapsed = GetTimeInNanoSecond (GetPerformanceCounter ()) - Start;
+  if (Elapsed == 0) {
+    return 0;
+  }
+
+  // CSR clock = frames * cycles per frame * divider / elapsed time
+  CsrClockHz = DivU64x64Remainder (
+                 MultU64x32 ((UINT64)PHY_MDC_CALIBRATE_FRAMES * MII_FRAME_MDC_CYCLES * Slowest->Divider, 1000000000),
+                 Elapsed,
+                 NULL
+                 );
+  CsrClockHz += CsrClockHz / 8;
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: MDIO calibration, CSR clock ~%ld Hz\r\n", CsrClockHz));
+  return (UINT32)MIN (CsrClockHz, MAX_UINT32);
+}
+
+/**
+	Find the MDIO bus driven by a GMAC.
+
+	@param MdioBaseAddress 	Register base address of the GMAC driving MDC/MDIO
+
+	@retval The MDIO bus, NULL if the bus is not configured.
+**/
+STATIC
+PHY_MDIO_BUS *
+PhyMdioFindBus (
+  IN UINTN    MdioBaseAddress
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < PHY_MDIO_BUS_MAX; Index++) {
+    if (mMdioBus[Index].MacBaseAddress == MdioBaseAddress) {
+      return &mMdioBus[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+	Configure the MDC divider of an MDIO bus.
+
+	@param MacBaseAddress 	Register base address of the GMAC driving MDC/MDIO
+	@param CsrClockHz		GMAC CSR clock, 0 to use PHY_GMAC_CSR_CLOCK_HZ or calibrate
+
+	@retval EFI_SUCCESS	    		The bus is configured.
+	@retval EFI_OUT_OF_RESOURCES	No free bus entry.
+**/
+EFI_STATUS
+EFIAPI
+PhyMdioConfigure (
+  IN  UINTN        MacBaseAddress,
+  IN  UINT32       CsrClockHz
+  )
+{
+  PHY_MDIO_BUS  *Bus;
+
+  Bus = PhyMdioFindBus (MacBaseAddress);
+  if (Bus == NULL) {
+    Bus = PhyMdioFindBus (0);
+  }
+  if (Bus == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (CsrClockHz == 0) {
+    CsrClockHz = PHY_GMAC_CSR_CLOCK_HZ;
+  }
+  if (CsrClockHz == 0 && PHY_MDC_CALIBRATE) {
+    CsrClockHz = PhyMdcCalibrate (MacBaseAddress);
+  }
+
+  Bus->MacBaseAddress = MacBaseAddress;
+  Bus->CsrClockHz = CsrClockHz;
+  Bus->ClockRange = (CsrClockHz != 0) ? PhyMdcClockRange (CsrClockHz) : MII_CLKRANGE_150_250M;
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Attach a GMAC to the MDIO bus its PHY sits on. Must be called before
+	PhyDxeInitialization of that GMAC, otherwise the GMAC is attached to
+	PHY_MDIO_SHARED_BUS_BASE, or to its own bus, on first MDIO access.
+	Every port of a shared bus must be attached with its PHY address.
+
+	@param MacBaseAddress 	GMAC register base address
+	@param MdioBaseAddress 	Register base address of the GMAC driving MDC/MDIO
+	@param PhyAddr 			PHY address of the port, PHY_ADDR_NONE to detect it
+
+	@retval EFI_SUCCESS	    		The GMAC is attached.
+	@retval EFI_ALREADY_STARTED		The GMAC is attached to another bus.
+	@retval EFI_OUT_OF_RESOURCES	No free bus or attach entry.
+**/
+EFI_STATUS
+EFIAPI
+PhyMdioAttach (
+  IN  UINTN        MacBaseAddress,
+  IN  UINTN        MdioBaseAddress,
+  IN  UINT32       PhyAddr
+  )
+{
+  PHY_MDIO_BUS     *Bus;
+  PHY_MDIO_ATTACH  *Attach;
+  UINTN            Index;
+  EFI_STATUS       Status;
+
+  Attach = NULL;
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mMdioAttach[Index].MacBaseAddress == MacBaseAddress) {
+      if (mMdioAttach[Index].Bus->MacBaseAddress != MdioBaseAddress) {
+        return EFI_ALREADY_STARTED;
+      }
+      mMdioAttach[Index].PhyAddr = PhyAddr;
+      return EFI_SUCCESS;
+    }
+    if (Attach == NULL && mMdioAttach[Index].MacBaseAddress == 0) {
+      Attach = &mMdioAttach[Index];
+    }
+  }
+  if (Attach == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Bus = PhyMdioFindBus (MdioBaseAddress);
+  if (Bus == NULL) {
+    Status = PhyMdioConfigure (MdioBaseAddress, 0);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Bus = PhyMdioFindBus (MdioBaseAddress);
+  }
+
+  if (PhyAddr >= PHY_MAX_ADDR) {
+    PhyAddr = PHY_ADDR_NONE;
+  }
+
+  Attach->MacBaseAddress = MacBaseAddress;
+  Attach->Bus = Bus;
+  Attach->PhyAddr = PhyAddr;
+  Bus->Users++;
+  if (MdioBaseAddress != MacBaseAddress) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: GMAC 0x%lx uses the MDIO bus of GMAC 0x%lx\r\n",
+            (UINT64)MacBaseAddress, (UINT64)MdioBaseAddress));
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+	Find the MDIO bus a GMAC is attached to, attaching it on first use.
+
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval The MDIO bus, NULL if the bus or attach table is full.
+**/
+STATIC
+PHY_MDIO_BUS *
+PhyMdioGetBus (
+  IN UINTN    MacBaseAddress
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mMdioAttach[Index].MacBaseAddress == MacBaseAddress) {
+      return mMdioAttach[Index].Bus;
+    }
+  }
+
+  if (EFI_ERROR (PhyMdioAttach (MacBaseAddress,
+                   (PHY_MDIO_SHARED_BUS_BASE != 0) ? PHY_MDIO_SHARED_BUS_BASE : MacBaseAddress,
+                   PHY_ADDR_NONE))) {
+    return NULL;
+  }
+  return PhyMdioGetBus (MacBaseAddress);
+}
+
+/**
+	Get the PHY address a GMAC was attached with.
+
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval The PHY address, PHY_ADDR_NONE if the port has to be detected.
+**/
+STATIC
+UINT32
+PhyMdioGetPortAddress (
+  IN UINTN    MacBaseAddress
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mMdioAttach[Index].MacBaseAddress == MacBaseAddress) {
+      return mMdioAttach[Index].PhyAddr;
+    }
+  }
+
+  return PHY_ADDR_NONE;
+}
+
+/**
+	Check whether other GMACs reach their PHY over the MDIO bus of a GMAC.
+
+	@param Bus 				The MDIO bus
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval TRUE	The bus is shared.
+	@retval FALSE	The GMAC is the only user of the bus.
+**/
+STATIC
+BOOLEAN
+PhyMdioIsShared (
+  IN PHY_MDIO_BUS   *Bus,
+  IN UINTN          MacBaseAddress
+  )
+{
+  return (BOOLEAN)(PHY_MDIO_SHARED_BUS_BASE != 0 || Bus->Users > 1 ||
+                   Bus->MacBaseAddress != MacBaseAddress);
+}
+
+/**
+	Detach a GMAC from its MDIO bus.
+
+	@param MacBaseAddress 	GMAC register base address
+**/
+STATIC
+VOID
+PhyMdioDetach (
+  IN UINTN    MacBaseAddress
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mMdioAttach[Index].MacBaseAddress == MacBaseAddress) {
+      if (mMdioAttach[Index].Bus->Users > 0) {
+        mMdioAttach[Index].Bus->Users--;
+      }
+      mMdioAttach[Index].MacBaseAddress = 0;
+      mMdioAttach[Index].Bus = NULL;
+      mMdioAttach[Index].PhyAddr = PHY_ADDR_NONE;
+      return;
+    }
+  }
+}
+
+/**
+	Run one MDIO frame on a bus. On a bus shared by several GMACs the frame
+	runs at TPL_NOTIFY, so the link timer of another port cannot start a frame
+	while the GMII address and data registers are in use.
+
+	@param Bus				MDIO bus
+	@param Addr				Phy device physical address
+	@param Reg 				Phy register
+	@param Write			TRUE for a write frame
+	@param Data				Data to write, or read data
+	@param BusyPolls		Number of busy bit reads
+
+	@retval EFI_SUCCESS	    The frame completed.
+	@retval EFI_TIMEOUT	    The frame did not complete.
+**/
+STATIC
+EFI_STATUS
+PhyMdioBusTransfer (
+  IN     PHY_MDIO_BUS  *Bus,
+  IN     UINT32        Addr,
+  IN     UINT32        Reg,
+  IN     BOOLEAN       Write,
+  IN OUT UINT32        *Data,
+  OUT    UINT32        *BusyPolls
+  )
+{
+  EFI_STATUS    Status;
+  EFI_TPL       OldTpl;
+
+  Bus->Frames++;
+  if (Bus->Users <= 1) {
+    return PhyMdioTransfer (Addr, Reg, Write, Data, Bus->ClockRange, Bus->MacBaseAddress, BusyPolls);
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  Status = PhyMdioTransfer (Addr, Reg, Write, Data, Bus->ClockRange, Bus->MacBaseAddress, BusyPolls);
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+	Read the ID of every address on an MDIO bus, once per bus. Later
+	detections on the same bus, including other ports, use the cached result.
+
+	@param Bus				MDIO bus
+**/
+STATIC
+VOID
+PhyMdioScan (
+  IN PHY_MDIO_BUS   *Bus
+  )
+{
+  UINT32    PhyAddr;
+  UINT32    PhyId;
+
+  if (Bus->Scanned) {
+    return;
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: Scanning MDIO bus of GMAC 0x%lx\r\n", (UINT64)Bus->MacBaseAddress));
+  for (PhyAddr = 0; PhyAddr < PHY_MAX_ADDR; PhyAddr++) {
+    if (Bus->PresentMask & (1U << PhyAddr)) {
+      continue;
+    }
+    if (!EFI_ERROR (PhyReadId (PhyAddr, &PhyId, Bus->MacBaseAddress))) {
+      Bus->PresentMask |= 1U << PhyAddr;
+      Bus->PhyId[PhyAddr] = PhyId;
+    }
+  }
+  Bus->Scanned = TRUE;
+}
+
+/**
+	Number of MDIO frames issued on a GMAC MDIO bus so far.
+
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval The MDIO frame count.
+**/
+UINT64
+EFIAPI
+PhyMdioGetFrameCount (
+  IN  UINTN        MacBaseAddress
+  )
+{
+  PHY_MDIO_BUS  *Bus;
+
+  Bus = PhyMdioGetBus (MacBaseAddress);
+  return (Bus != NULL) ? Bus->Frames : 0;
+}
+
+/**
+	Keep the result of a read of registers 0-15 for PhyMdioPollRead. A write
+	drops the register, a write of PHY_BASIC_CTRL drops every register.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Reg 				Phy register
+	@param Write			TRUE for a write frame
+	@param Data				Read data, NULL if the frame failed
+**/
+STATIC
+VOID
+PhyMdioRecord (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINT32       Reg,
+  IN BOOLEAN      Write,
+  IN UINT32       *Data OPTIONAL
+  )
+{
+  if (Reg >= PHY_SHADOW_REG_NUM) {
+    return;
+  }
+
+  if (Write && Reg == PHY_BASIC_CTRL) {
+    ZeroMem (PhyDriver->RecentReadTime, sizeof (PhyDriver->RecentReadTime));
+  } else if (Write || Data == NULL) {
+    PhyDriver->RecentReadTime[Reg] = 0;
+  } else {
+    PhyDriver->RecentRead[Reg] = (UINT16)*Data;
+    PhyDriver->RecentReadTime[Reg] = PhyGetTimeUs ();
+  }
+}
+
+/**
+	Run one MDIO frame on the bus of a GMAC and account it to the phy instance
+	at that address.
+
+	@param Addr				Phy device physical address
+	@param Reg 				Phy register
+	@param Write			TRUE for a write frame
+	@param Data				Data to write, or read data
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    The frame completed.
+	@retval EFI_TIMEOUT	    MDIO busy bit timeout
+**/
+STATIC
+EFI_STATUS
+PhyMdioAccess (
+  IN     UINT32   Addr,
+  IN     UINT32   Reg,
+  IN     BOOLEAN  Write,
+  IN OUT UINT32   *Data,
+  IN     UINTN    MacBaseAddress
+  )
+{
+  PHY_MDIO_BUS       *Bus;
+  PHY_MDIO_COUNTERS  *Counters;
+  EFI_STATUS         Status;
+  UINT32             BusyPolls;
+  UINTN              Index;
+
+  Bus = PhyMdioGetBus (MacBaseAddress);
+  if (Bus == NULL) {
+    Status = PhyMdioTransfer (Addr, Reg, Write, Data, MII_CLKRANGE_150_250M, MacBaseAddress, &BusyPolls);
+  } else {
+    Status = PhyMdioBusTransfer (Bus, Addr, Reg, Write, Data, &BusyPolls);
+  }
+
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mPhyInstances[Index] != NULL &&
+        mPhyInstances[Index]->MacBaseAddress == MacBaseAddress &&
+        mPhyInstances[Index]->PhyAddr == Addr) {
+      Counters = &mPhyInstances[Index]->MdioCounters;
+      if (Write) {
+        Counters->Writes++;
+      } else {
+        Counters->Reads++;
+      }
+      Counters->BusyPolls += BusyPolls;
+      if (Status == EFI_TIMEOUT) {
+        Counters->Timeouts++;
+      }
+      PhyMdioRecord (mPhyInstances[Index], Reg, Write, EFI_ERROR (Status) ? NULL : Data);
+      break;
+    }
+  }
+
+  if (Status == EFI_TIMEOUT) {
+    PhyTrace (PhyTraceMdioTimeout, Addr, Reg, Write);
+  }
+
+  return Status;
+}
+
+/**
+	Function to read from MII register (PHY Access).
+
+	@param Addr				Phy device physical address
+	@param Reg 				Phy register
+	@param Data				Read data
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Read success
+	@retval EFI_TIMEOUT	    MDIO busy bit timeout
+**/
+EFI_STATUS
+EFIAPI
+PhyRead (
+  IN  UINT32   Addr,
+  IN  UINT32   Reg,
+  OUT UINT32   *Data,
+  IN  UINTN    MacBaseAddress
+  )
+{
+  // Check it is a valid Reg
+  /* ynfan 20210915 */
+  // ASSERT (Reg < 31);
+
+  return PhyMdioAccess (Addr, Reg, FALSE, Data, MacBaseAddress);
+}
+
+/**
+	Function to write to the MII register (PHY Access).
+
+	@param Addr			  Phy device physical address
+	@param Reg			  Phy register
+	@param Data			  Data to write
+	@param MacBaseAddress GMAC register base address
+
+	@retval EFI_SUCCESS	  Write success
+	@retval EFI_TIMEOUT	  MDIO busy bit timeout
+**/
+
+// Function to write to the MII register (PHY Access)
+EFI_STATUS
+EFIAPI
+PhyWrite (
+  IN UINT32   Addr,
+  IN UINT32   Reg,
+  IN UINT32   Data,
+  IN UINTN    MacBaseAddress
+  )
+{
+  // Check it is a valid Reg
+  // ASSERT(Reg < 31);
+
+  return PhyMdioAccess (Addr, Reg, TRUE, &Data, MacBaseAddress);
+}
+
+/**
+	Run a batch of MDIO operations on a phy back to back at PHY_MDIO_BATCH_TPL.
+	No other frame, from the link timer or another port on the bus, is issued
+	between two operations of the batch. The batch stops at the first failed
+	operation.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Ops				Operations, read data is returned in place
+	@param Count			Number of operations
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Every operation completed.
+	@retval EFI_TIMEOUT	    MDIO busy bit timeout
+**/
+EFI_STATUS
+EFIAPI
+PhyMdioRunBatch (
+  IN     PHY_DRIVER   *PhyDriver,
+  IN OUT PHY_MDIO_OP  *Ops,
+  IN     UINTN        Count,
+  IN     UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  EFI_TPL       OldTpl;
+  UINT32        Data32;
+  UINTN         Index;
+
+  Status = EFI_SUCCESS;
+  OldTpl = gBS->RaiseTPL (PHY_MDIO_BATCH_TPL);
+  for (Index = 0; Index < Count; Index++) {
+    Data32 = Ops[Index].Data;
+    Status = PhyMdioAccess (PhyDriver->PhyAddr, Ops[Index].Reg, (BOOLEAN)(Ops[Index].Op == PHY_MDIO_OP_WRITE),
+               &Data32, MacBaseAddress);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    Ops[Index].Data = (UINT16)Data32;
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+	Read a PHY register for a link poll. A read of the same register among
+	registers 0-15 completed within PHY_MDIO_JOIN_US is joined instead of
+	issuing another frame. Registers that clear on read must use PhyRead.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Reg 				Phy register
+	@param Data				Read data
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Read success
+	@retval EFI_TIMEOUT	    MDIO busy bit timeout
+**/
+EFI_STATUS
+EFIAPI
+PhyMdioPollRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  if (Reg < PHY_SHADOW_REG_NUM && PhyDriver->RecentReadTime[Reg] != 0 &&
+      PhyGetTimeUs () - PhyDriver->RecentReadTime[Reg] < PHY_MDIO_JOIN_US) {
+    *Data = PhyDriver->RecentRead[Reg];
+    return EFI_SUCCESS;
+  }
+
+  return PhyRead (PhyDriver->PhyAddr, Reg, Data, MacBaseAddress);
+}
+
+/**
+	Run a register access with the page select it needs as one batch, so a
+	poll on another page cannot run in between.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Page				Phy register page
+	@param Reg				Phy register
+	@param Write			TRUE for a write
+	@param Data				Data to write, or read data
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    The access completed.
+**/
+STATIC
+EFI_STATUS
+PhyPagedAccess (
+  IN     PHY_DRIVER   *PhyDriver,
+  IN     UINT32       Page,
+  IN     UINT32       Reg,
+  IN     BOOLEAN      Write,
+  IN OUT UINT32       *Data,
+  IN     UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  PHY_MDIO_OP   Ops[2];
+  UINTN         Count;
+
+  Count = 0;
+  if (PhyDriver->CurrentPage != Page) {
+    Ops[Count].Op = PHY_MDIO_OP_WRITE;
+    Ops[Count].Reg = PHY_SPECIAL_PHY_CTLR;
+    Ops[Count].Data = (UINT16)Page;
+    Count++;
+  }
+  Ops[Count].Op = Write ? PHY_MDIO_OP_WRITE : PHY_MDIO_OP_READ;
+  Ops[Count].Reg = (UINT8)Reg;
+  Ops[Count].Data = (UINT16)*Data;
+  Count++;
+
+  Status = PhyMdioRunBatch (PhyDriver, Ops, Count, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    PhyDriver->CurrentPage = PHY_PAGE_UNKNOWN;
+    return Status;
+  }
+
+  PhyDriver->CurrentPage = Page;
+  *Data = Ops[Count - 1].Data;
+  return EFI_SUCCESS;
+}
+
+/**
+	Select a PHY register page, skipped when the page is already selected.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Page				Phy register page
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    The page is selected.
+**/
+STATIC
+EFI_STATUS
+PhySelectPage (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Page,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+
+  if (PhyDriver->CurrentPage == Page) {
+    return EFI_SUCCESS;
+  }
+
+  Status = PhyWrite (PhyDriver->PhyAddr, PHY_SPECIAL_PHY_CTLR, Page, MacBaseAddress);
+  PhyDriver->CurrentPage = EFI_ERROR (Status) ? PHY_PAGE_UNKNOWN : Page;
+  return Status;
+}
+
+/**
+	Leave the default page selected, the page the next owner of the PHY (the OS
+	driver or the next boot stage) expects. Nothing is written unless another
+	page was selected.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param MacBaseAddress 	GMAC register base address
+**/
+STATIC
+VOID
+PhyRestoreDefaultPage (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  if (PhyDriver->PhyAddr == PHY_ADDR_NONE ||
+      PhyDriver->CurrentPage == PHY_PAGE_UNKNOWN ||
+      PhyDriver->CurrentPage == RTL8211F_DEFAULT_PAGE) {
+    return;
+  }
+
+  PhySelectPage (PhyDriver, RTL8211F_DEFAULT_PAGE, MacBaseAddress);
+}
+
+/**
+	Read a paged PHY register (RTL8211F page select in PHY_SPECIAL_PHY_CTLR).
+	The page is left selected and only written again when a different page is
+	needed, registers 0-15 are not paged.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Page				Phy register page
+	@param Reg				Phy register
+	@param Data				Read data
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Read success
+**/
+EFI_STATUS
+EFIAPI
+PhyPagedRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Page,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  *Data = 0;
+  return PhyPagedAccess (PhyDriver, Page, Reg, FALSE, Data, MacBaseAddress);
+}
+
+/**
+	Write a paged PHY register (RTL8211F page select in PHY_SPECIAL_PHY_CTLR).
+	The page is left selected, see PhyPagedRead.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Page				Phy register page
+	@param Reg				Phy register
+	@param Data				Data to write
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Write success
+**/
+EFI_STATUS
+EFIAPI
+PhyPagedWrite (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Page,
+  IN  UINT32       Reg,
+  IN  UINT32       Data,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  return PhyPagedAccess (PhyDriver, Page, Reg, TRUE, &Data, MacBaseAddress);
+}
+
+/**
+	Read a PHY register through the PHY_DRIVER shadow copy.
+	Static registers in PHY_SHADOW_REG_MASK are read from MDIO once and then served
+	from the shadow copy, every other register always hits the MDIO bus.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Reg				Phy register
+	@param Data				Read data
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Read success
+**/
+EFI_STATUS
+EFIAPI
+PhyShadowRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+
+  if (Reg >= PHY_SHADOW_REG_NUM || (PHY_SHADOW_REG_MASK & (1 << Reg)) == 0) {
+    return PhyRead (PhyDriver->PhyAddr, Reg, Data, MacBaseAddress);
+  }
+
+  if (PhyDriver->ShadowValid & (1 << Reg)) {
+    *Data = PhyDriver->ShadowReg[Reg];
+    return EFI_SUCCESS;
+  }
+
+  Status = PhyRead (PhyDriver->PhyAddr, Reg, Data, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Do not cache a control value while a reset or AN restart is still in progress
+  if (Reg == PHY_BASIC_CTRL && (*Data & PHYCTRL_SELF_CLEAR) != 0) {
+    return EFI_SUCCESS;
+  }
+
+  PhyDriver->ShadowReg[Reg] = (UINT16)*Data;
+  PhyDriver->ShadowValid |= (1 << Reg);
+  return EFI_SUCCESS;
+}
+
+/**
+	Write a PHY register through the PHY_DRIVER shadow copy.
+	A write of the value already held for a shadowed register is skipped.
+	A PHY reset drops the whole shadow copy.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Reg				Phy register
+	@param Data				Data to write
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS	    Write success
+**/
+EFI_STATUS
+EFIAPI
+PhyShadowWrite (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Reg,
+  IN  UINT32       Data,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  BOOLEAN       Shadowed;
+
+  Data &= 0xFFFF;
+  Shadowed = (BOOLEAN)(Reg < PHY_SHADOW_REG_NUM && (PHY_SHADOW_REG_MASK & (1 << Reg)) != 0);
+
+  if (Shadowed &&
+      (PhyDriver->ShadowValid & (1 << Reg)) != 0 &&
+      PhyDriver->ShadowReg[Reg] == Data) {
+    return EFI_SUCCESS;
+  }
+
+  Status = PhyWrite (PhyDriver->PhyAddr, Reg, Data, MacBaseAddress);
+  if (!Shadowed) {
+    return Status;
+  }
+
+  if (EFI_ERROR (Status) || (Reg == PHY_BASIC_CTRL && (Data & PHYCTRL_RESET) != 0)) {
+    PhyShadowInvalidate (PhyDriver);
+    return Status;
+  }
+
+  // Self-clearing bits read back as zero once the PHY has acted on them
+  if (Reg == PHY_BASIC_CTRL) {
+    Data &= ~PHYCTRL_SELF_CLEAR;
+  }
+  PhyDriver->ShadowReg[Reg] = (UINT16)Data;
+  PhyDriver->ShadowValid |= (1 << Reg);
+  return EFI_SUCCESS;
+}
+
+/**
+	Drop the PHY_DRIVER shadow copy and the selected page, the next access of
+	every register hits MDIO.
+
+	@param PhyDriver		A point to Phy dirver structure
+**/
+VOID
+EFIAPI
+PhyShadowInvalidate (
+  IN  PHY_DRIVER   *PhyDriver
+  )
+{
+  PhyDriver->ShadowValid = 0;
+  PhyDriver->CurrentPage = PHY_PAGE_UNKNOWN;
+}
+
+/**
+	Check that a PHY init script is in effect, without writing the PHY.
+	Writes and MMD writes must read back their value, modifies must leave the
+	register unchanged, page selects are followed and waits are skipped.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Script			Script operations
+	@param Count			Number of operations
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval TRUE			Every register holds the script value.
+	@retval FALSE			A register differs or could not be read.
+**/
+BOOLEAN
+EFIAPI
+PhyCheckScript (
+  IN  PHY_DRIVER           *PhyDriver,
+  IN  CONST PHY_SCRIPT_OP  *Script,
+  IN  UINTN                Count,
+  IN  UINTN                MacBaseAddress
+  )
+{
+  UINTN         Index;
+  UINT32        Data32;
+  EFI_STATUS    Status;
+
+  for (Index = 0; Index < Count; Index++) {
+    switch (Script[Index].Op) {
+      case PhyScriptWrite:
+      case PhyScriptModify:
+        Status = PhyShadowRead (PhyDriver, Script[Index].Reg, &Data32, MacBaseAddress);
+        if (EFI_ERROR (Status) ||
+            ((Data32 & ~(UINT32)Script[Index].Mask) | Script[Index].Value) != Data32) {
+          return FALSE;
+        }
+        break;
+
+      case PhyScriptPage:
+        if (EFI_ERROR (PhySelectPage (PhyDriver, Script[Index].Value, MacBaseAddress))) {
+          return FALSE;
+        }
+        break;
+
+      case PhyScriptMmdWrite:
+        Status = PhyMmdRead (PhyDriver, Script[Index].Dev, Script[Index].Reg, &Data32, MacBaseAddress);
+        if (EFI_ERROR (Status) || (UINT16)Data32 != Script[Index].Value) {
+          return FALSE;
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+	Run a PHY init script.
+	MMD writes to consecutive registers of one device are merged into a post
+	increment block write, page selects of the page already selected are dropped, a modify of a shadowed
+	register takes its old value from the shadow copy instead of MDIO, and a write
+	or modify that would not change the register is skipped. The script stops at
+	the first failing operation.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param Name				Script name, for the debug report
+	@param Script			Script operations
+	@param Count			Number of script operations
+	@param MacBaseAddress 	GMAC register base address
+	@param Stats			Operations, MDIO frames and time spent, optional
+
+	@retval EFI_SUCCESS	    The whole script ran.
+	@retval other		    The status of the failing operation.
+**/
+EFI_STATUS
+EFIAPI
+PhyRunScript (
+  IN  PHY_DRIVER           *PhyDriver,
+  IN  CONST CHAR8          *Name,
+  IN  CONST PHY_SCRIPT_OP  *Script,
+  IN  UINTN                Count,
+  IN  UINTN                MacBaseAddress,
+  OUT PHY_SCRIPT_STATS     *Stats OPTIONAL
+  )
+{
+  EFI_STATUS    Status;
+  UINTN         Index;
+  UINT32        Data32;
+  UINT32        Value;
+  UINT64        Start;
+  UINT64        Frames;
+  UINTN         Run;
+  UINTN         Current;
+  UINT16        Block[PHY_MMD_BLOCK_MAX];
+
+  Status = EFI_SUCCESS;
+  Start = PhyGetTimeUs ();
+  Frames = PhyMdioGetFrameCount (MacBaseAddress);
+
+  // Current is the first op of the step, a merged MMD block spans several ops
+  Current = 0;
+  for (Index = 0; Index < Count && !EFI_ERROR (Status); Index++) {
+    Current = Index;
+    switch (Script[Index].Op) {
+      case PhyScriptWrite:
+        Status = PhyShadowWrite (PhyDriver, Script[Index].Reg, Script[Index].Value, MacBaseAddress);
+        break;
+
+      case PhyScriptModify:
+        Status = PhyShadowRead (PhyDriver, Script[Index].Reg, &Data32, MacBaseAddress);
+        if (EFI_ERROR (Status)) {
+          break;
+        }
+        Value = (Data32 & ~(UINT32)Script[Index].Mask) | Script[Index].Value;
+        if (Value != Data32) {
+          Status = PhyShadowWrite (PhyDriver, Script[Index].Reg, Value, MacBaseAddress);
+        }
+        break;
+
+      case PhyScriptPage:
+        Status = PhySelectPage (PhyDriver, Script[Index].Value, MacBaseAddress);
+        break;
+
+      case PhyScriptMmdWrite:
+        // Writes to consecutive registers of one MMD device go out as a single block
+        for (Run = 0; Run < PHY_MMD_BLOCK_MAX && Index + Run < Count; Run++) {
+          if (Script[Index + Run].Op != PhyScriptMmdWrite ||
+              Script[Index + Run].Dev != Script[Index].Dev ||
+              Script[Index + Run].Reg != Script[Index].Reg + Run) {
+            break;
+          }
+          Block[Run] = Script[Index + Run].Value;
+        }
+        Status = PhyMmdWriteBlock (PhyDriver, Script[Index].Dev, Script[Index].Reg, Run, Block,
+                   MacBaseAddress);
+        Index += Run - 1;
+        break;
+
+      case PhyScriptPoll:
+        Status = PhyPollRegister (PhyDriver, Script[Index].Reg, Script[Index].Mask, Script[Index].Value,
+                   Script[Index].Arg, MacBaseAddress);
+        break;
+
+      case PhyScriptDelay:
+        MicroSecondDelay (Script[Index].Arg);
+        break;
+
+      default:
+        Status = EFI_INVALID_PARAMETER;
+        break;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "SNP:PHY: script %a failed at op %u - %r\r\n", Name, (UINT32)Current, Status));
+    Index = Current;
+  }
 
-  return EFI_SUCCESS;
+  Frames = PhyMdioGetFrameCount (MacBaseAddress) - Frames;
+  Start = PhyGetTimeUs () - Start;
+  DEBUG ((DEBUG_INFO, "SNP:PHY: script %a: %u ops, %ld MDIO frames, %ld us\r\n",
+          Name, (UINT32)Index, Frames, Start));
+  if (Stats != NULL) {
+    Stats->Ops = (UINT32)Index;
+    Stats->Frames = (UINT32)Frames;
+    Stats->ElapsedUs = Start;
+  }
+
+  return Status;
 }
 
 /**
-	Display phy capability.
+	Fill the operations that set up an MMD access through clause 22 registers
+	13/14 (IEEE 802.3 Annex 22D).
 
-	@param speed			  ethernet speed,10M/100M/1000M
-	@param duplex 		  	  Duplex mode,half/full
+	@param Ops				PHY_MMD_SETUP_OPS operations to fill
+	@param DevAddr			MMD device address
+	@param Reg				MMD register
+	@param Function			PHY_MMD_FUNC_xxx used for the following data accesses
+
+	@retval PHY_MMD_SETUP_OPS
 **/
-VOID
-EFIAPI
-PhyDisplayAbility (
-  IN UINT32   Speed,
-  IN UINT32   Duplex
+STATIC
+UINTN
+PhyMmdSetup (
+  OUT PHY_MDIO_OP  *Ops,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  IN  UINT32       Function
   )
 {
+  DevAddr &= PHY_MMD_DEVAD_MASK;
+  Ops[0].Op = PHY_MDIO_OP_WRITE;
+  Ops[0].Reg = PHY_MMD_ACCESS_CTRL;
+  Ops[0].Data = (UINT16)((PHY_MMD_FUNC_ADDRESS << PHY_MMD_FUNC_SHIFT) | DevAddr);
+  Ops[1].Op = PHY_MDIO_OP_WRITE;
+  Ops[1].Reg = PHY_MMD_ACCESS_DATA;
+  Ops[1].Data = (UINT16)Reg;
+  Ops[2].Op = PHY_MDIO_OP_WRITE;
+  Ops[2].Reg = PHY_MMD_ACCESS_CTRL;
+  Ops[2].Data = (UINT16)((Function << PHY_MMD_FUNC_SHIFT) | DevAddr);
+
+  return PHY_MMD_SETUP_OPS;
+}
 
-  DEBUG ((DEBUG_INFO, "SNP:PHY: "));
-  switch (Speed) {
-    case SPEED_1000:
-      DEBUG ((DEBUG_INFO, "1 Gbps - "));
-      break;
-    case SPEED_100:
-      DEBUG ((DEBUG_INFO, "100 Mbps - "));
-      break;
-    case SPEED_10:
-      DEBUG ((DEBUG_INFO, "10 Mbps - "));
-      break;
-    default:
-      DEBUG ((DEBUG_INFO, "Invalid link speed"));
-      break;
+/**
+	Access MMD registers, the setup and the data accesses of up to
+	PHY_MMD_BLOCK_MAX registers run as one MDIO batch.
+
+	@param PhyDriver		A point to Phy dirver structure
+	@param DevAddr			MMD device address
+	@param Reg				First MMD register
+	@param Function			PHY_MMD_FUNC_xxx of the data accesses
+	@param Write			TRUE for writes
+	@param Count			Number of data accesses
+	@param Buffer			Data to write, or read data
+	@param MacBaseAddress 	GMAC register base address
+
+	@retval EFI_SUCCESS		Access success
+**/
+STATIC
+EFI_STATUS
+PhyMmdAccess (
+  IN     PHY_DRIVER   *PhyDriver,
+  IN     UINT32       DevAddr,
+  IN     UINT32       Reg,
+  IN     UINT32       Function,
+  IN     BOOLEAN      Write,
+  IN     UINTN        Count,
+  IN OUT UINT16       *Buffer,
+  IN     UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+  PHY_MDIO_OP   Ops[PHY_MMD_SETUP_OPS + PHY_MMD_BLOCK_MAX];
+  UINTN         Setup;
+  UINTN         Run;
+  UINTN         Index;
+
+  Status = EFI_SUCCESS;
+  while (Count > 0 && !EFI_ERROR (Status)) {
+    Run = MIN (Count, PHY_MMD_BLOCK_MAX);
+    Setup = PhyMmdSetup (Ops, DevAddr, Reg, Function);
+    for (Index = 0; Index < Run; Index++) {
+      Ops[Setup + Index].Op = Write ? PHY_MDIO_OP_WRITE : PHY_MDIO_OP_READ;
+      Ops[Setup + Index].Reg = PHY_MMD_ACCESS_DATA;
+      Ops[Setup + Index].Data = Write ? Buffer[Index] : 0;
     }
 
-  switch (Duplex) {
-    case DUPLEX_FULL:
-      DEBUG ((DEBUG_INFO, "Full Duplex\n"));
-      break;
-    case DUPLEX_HALF:
-      DEBUG ((DEBUG_INFO, "Half Duplex\n"));
-      break;
-    default:
-      DEBUG ((DEBUG_INFO, "Invalid duplex mode\n"));
-      break;
+    Status = PhyMdioRunBatch (PhyDriver, Ops, Setup + Run, MacBaseAddress);
+    if (!EFI_ERROR (Status) && !Write) {
+      for (Index = 0; Index < Run; Index++) {
+        Buffer[Index] = Ops[Setup + Index].Data;
+      }
     }
+
+    Buffer += Run;
+    Reg += (UINT32)Run;
+    Count -= Run;
+  }
+
+  return Status;
 }
 
 /**
-	Function to read from MII register (PHY Access).
+	Read consecutive MMD registers, the address is set up once and the data
+	register post-increments after every read.
 
-	@param Addr				Phy device physical address
-	@param Reg 				Phy register
-	@param Data				Read data
+	@param PhyDriver		A point to Phy dirver structure
+	@param DevAddr			MMD device address
+	@param Reg				First MMD register
+	@param Count			Number of registers
+	@param Buffer			Read data
 	@param MacBaseAddress 	GMAC register base address
 
-	@retval EFI_SUCCESS	    Read success
+	@retval EFI_SUCCESS		Read success
 **/
 EFI_STATUS
 EFIAPI
-PhyRead (
-  IN  UINT32   Addr,
-  IN  UINT32   Reg,
-  OUT UINT32   *Data,
-  IN  UINTN    MacBaseAddress
+PhyMmdReadBlock (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  IN  UINTN        Count,
+  OUT UINT16       *Buffer,
+  IN  UINTN        MacBaseAddress
   )
 {
-  UINT32        MiiConfig;
-  UINT32        Count;
-
-  // Check it is a valid Reg
-  /* ynfan 20210915 */
-  // ASSERT (Reg < 31);
+  return PhyMmdAccess (PhyDriver, DevAddr, Reg,
+           (Count > 1) ? PHY_MMD_FUNC_DATA_POST_INC_RW : PHY_MMD_FUNC_DATA,
+           FALSE, Count, Buffer, MacBaseAddress);
+}
 
-  MiiConfig = ((Addr << MIIADDRSHIFT) & MII_ADDRMSK) |
-              ((Reg << MIIREGSHIFT) & MII_REGMSK)|
-               MII_CLKRANGE_150_250M |
-               MII_BUSY;
+/**
+	Write consecutive MMD registers, the address is set up once and the data
+	register post-increments after every write.
 
-  // write this config to register
-  MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST, MiiConfig);
+	@param PhyDriver		A point to Phy dirver structure
+	@param DevAddr			MMD device address
+	@param Reg				First MMD register
+	@param Count			Number of registers
+	@param Buffer			Data to write
+	@param MacBaseAddress 	GMAC register base address
 
-  // Wait for busy bit to clear
-  Count = 0;
-  while (Count < 10000) {
-    if (!(DW_EMAC_GMACGRP_GMII_ADDRESS_GB_GET (MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST)))) {
-      *Data = DW_EMAC_GMACGRP_GMII_DATA_GD_GET (MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_DATA_OFST));
-      return EFI_SUCCESS;
-    }
-    MemoryFence ();
-    Count++;
-  };
-  DEBUG ((DEBUG_INFO, "SNP:PHY: MDIO busy bit timeout\r\n"));
-  return EFI_TIMEOUT;
+	@retval EFI_SUCCESS		Write success
+**/
+EFI_STATUS
+EFIAPI
+PhyMmdWriteBlock (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  IN  UINTN        Count,
+  IN  CONST UINT16 *Buffer,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  return PhyMmdAccess (PhyDriver, DevAddr, Reg,
+           (Count > 1) ? PHY_MMD_FUNC_DATA_POST_INC_W : PHY_MMD_FUNC_DATA,
+           TRUE, Count, (UINT16 *)Buffer, MacBaseAddress);
 }
 
 /**
-	Function to write to the MII register (PHY Access).
+	Read one MMD register.
 
-	@param Addr			  Phy device physical address
-	@param Reg			  Phy register
-	@param Data			  Data to write
-	@param MacBaseAddress GMAC register base address
+	@param PhyDriver		A point to Phy dirver structure
+	@param DevAddr			MMD device address
+	@param Reg				MMD register
+	@param Data				Read data
+	@param MacBaseAddress 	GMAC register base address
 
-	@retval EFI_SUCCESS	  Write success
+	@retval EFI_SUCCESS		Read success
 **/
-
-// Function to write to the MII register (PHY Access)
 EFI_STATUS
 EFIAPI
-PhyWrite (
-  IN UINT32   Addr,
-  IN UINT32   Reg,
-  IN UINT32   Data,
-  IN UINTN    MacBaseAddress
+PhyMmdRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
   )
 {
-  UINT32   MiiConfig;
-  UINT32   Count;
+  EFI_STATUS    Status;
+  UINT16        Data16;
 
-  // Check it is a valid Reg
-  // ASSERT(Reg < 31);
+  Status = PhyMmdAccess (PhyDriver, DevAddr, Reg, PHY_MMD_FUNC_DATA, FALSE, 1, &Data16, MacBaseAddress);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  *Data = Data16;
+  return EFI_SUCCESS;
+}
 
-  MiiConfig = ((Addr << MIIADDRSHIFT) & MII_ADDRMSK) |
-              ((Reg << MIIREGSHIFT) & MII_REGMSK)|
-               MII_WRITE |
-               MII_CLKRANGE_150_250M |
-               MII_BUSY;
-  // Write the desired value to the register first
-  MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_DATA_OFST, (Data & 0xFFFF));
+/**
+	Write one MMD register.
 
-  // write this config to register
-  MmioWrite32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST, MiiConfig);
+	@param PhyDriver		A point to Phy dirver structure
+	@param DevAddr			MMD device address
+	@param Reg				MMD register
+	@param Data				Data to write
+	@param MacBaseAddress 	GMAC register base address
 
-  // Wait for busy bit to clear
-  Count = 0;
-  while (Count < 1000) {
-    if (!(DW_EMAC_GMACGRP_GMII_ADDRESS_GB_GET (MmioRead32 (MacBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST)))) {
-      return EFI_SUCCESS;
-    }
-    MemoryFence ();
-    Count++;
-  };
+	@retval EFI_SUCCESS		Write success
+**/
+EFI_STATUS
+EFIAPI
+PhyMmdWrite (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  IN  UINT32       Data,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  UINT16        Data16;
 
-  return EFI_TIMEOUT;
+  Data16 = (UINT16)Data;
+  return PhyMmdAccess (PhyDriver, DevAddr, Reg, PHY_MMD_FUNC_DATA, TRUE, 1, &Data16, MacBaseAddress);
 }
 
 /**
@@ -823,10 +4673,7 @@ Phy9031ExtendedWrite (
   IN UINTN        MacBaseAddress
   )
 {
-  PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_CTRL_REG, DevAddr, MacBaseAddress);
-  PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_REGDATA_REG, Regnum, MacBaseAddress);
-  PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_CTRL_REG, (Mode << 14) | DevAddr, MacBaseAddress);
-  return PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_REGDATA_REG, Val, MacBaseAddress);
+  return PhyMmdAccess (PhyDriver, DevAddr, Regnum, Mode, TRUE, 1, &Val, MacBaseAddress);
 }
 
 /**
@@ -852,31 +4699,282 @@ Phy9031ExtendedRead (
   )
 {
   EFI_STATUS    Status;
-  UINT32        Data32;
-
-  PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_CTRL_REG, DevAddr, MacBaseAddress);
-  PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_REGDATA_REG, Regnum, MacBaseAddress);
-  PhyWrite (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_CTRL_REG, (Mode << 14) | DevAddr, MacBaseAddress);
+  UINT16        Data16;
 
-  Status = PhyRead (PhyDriver->PhyAddr, PHY_KSZ9031RN_MMD_REGDATA_REG, &Data32, MacBaseAddress);
+  Status = PhyMmdAccess (PhyDriver, DevAddr, Regnum, Mode, FALSE, 1, &Data16, MacBaseAddress);
   if (EFI_ERROR (Status)) {
     return 0;
   }
 
-  return Data32;
+  return Data16;
+}
+
+//
+// Receive error counter of each PHY. AR8035 and RTL8211F have no supported
+// counter in their MII registers, their receive errors are not counted.
+//
+STATIC CONST PHY_RX_ERROR_COUNTER  mPhyRxErrorCounters[] = {
+  { PHY_ID_KSZ9031, PHY_ID_MASK_NO_REV, PHY_COUNTER_NO_PAGE, PHY_KSZ9031RN_RXER_CNT_REG, FALSE },
+  { PHY_ID_LAN8720, PHY_ID_MASK_NO_REV, PHY_COUNTER_NO_PAGE, LAN87XX_SYMBOL_ERR_CNT_REG, TRUE },
+  { PHY_ID_LAN8742, PHY_ID_MASK_NO_REV, PHY_COUNTER_NO_PAGE, LAN87XX_SYMBOL_ERR_CNT_REG, TRUE }
+};
+
+/**
+	Read PHY_1000BASE_T_STATUS and fold the idle error count, cleared by the
+	read, into Counters.IdleErrors. Every read of the register goes through
+	here so no idle error is lost.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param GigStatus			PHY_1000BASE_T_STATUS
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    The register was read.
+**/
+STATIC
+EFI_STATUS
+PhyReadGigStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *GigStatus,
+  IN  UINTN        MacBaseAddress
+  )
+{
+  EFI_STATUS    Status;
+
+  Status = PhyRead (PhyDriver->PhyAddr, PHY_1000BASE_T_STATUS, GigStatus, MacBaseAddress);
+  if (!EFI_ERROR (Status)) {
+    PhyDriver->Counters.IdleErrors += *GigStatus & PHYLPA_1000_IDLE_ERR_MASK;
+  }
+  return Status;
+}
+
+/**
+	Sample the PHY error counters, and the GMAC MMC counters through EmacMmcSample, into the 64-bit
+	totals of the port.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param MacBaseAddress 		GMAC register base address
+**/
+STATIC
+VOID
+PhySampleCounters (
+  IN PHY_DRIVER   *PhyDriver,
+  IN UINTN        MacBaseAddress
+  )
+{
+  PHY_COUNTERS                 *Counters;
+  CONST PHY_RX_ERROR_COUNTER   *RxError;
+  EFI_STATUS                   Status;
+  UINT32                       Data32;
+  UINTN                        Index;
+
+  Counters = &PhyDriver->Counters;
+  Counters->SampleTime = PhyGetTimeUs ();
+
+  if (PhyDriver->PhyAddr != PHY_ADDR_NONE) {
+    for (Index = 0; Index < ARRAY_SIZE (mPhyRxErrorCounters); Index++) {
+      RxError = &mPhyRxErrorCounters[Index];
+      if ((PhyDriver->PhyId & RxError->PhyIdMask) != (RxError->PhyId & RxError->PhyIdMask)) {
+        continue;
+      }
+      if (RxError->Page == PHY_COUNTER_NO_PAGE) {
+        Status = PhyRead (PhyDriver->PhyAddr, RxError->Reg, &Data32, MacBaseAddress);
+      } else {
+        Status = PhyPagedRead (PhyDriver, RxError->Page, RxError->Reg, &Data32, MacBaseAddress);
+      }
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+      if (RxError->RollOver) {
+        Counters->RxErrors += (UINT16)(Data32 - Counters->RxErrorLast);
+        Counters->RxErrorLast = (UINT16)Data32;
+      } else {
+        Counters->RxErrors += Data32 & 0xFFFF;
+      }
+      break;
+    }
+
+    if (PhyDriver->MacSpeed == SPEED_1000) {
+      PhyReadGigStatus (PhyDriver, &Data32, MacBaseAddress);
+    }
+  }
+
+  EmacMmcSample (&Counters->Mmc, MacBaseAddress);
+}
+
+/**
+	Fill the SNP statistics of a port from the GMAC MMC counters, for the
+	Statistics () service of the Simple Network Protocol. EFI_NETWORK_STATISTICS
+	has no field for PHY errors, the PHY receive and idle errors are only
+	reported in the debug log. Fields without a counter are left untouched.
+
+	@param PhyDriver			A point to Phy dirver structure
+	@param Reset				Reset the counters after they are read
+	@param Statistics			SNP statistics to fill, NULL to only reset
+	@param MacBaseAddress 		GMAC register base address
+
+	@retval EFI_SUCCESS		    The statistics were collected.
+**/
+EFI_STATUS
+EFIAPI
+PhyCollectStatistics (
+  IN  PHY_DRIVER              *PhyDriver,
+  IN  BOOLEAN                 Reset,
+  OUT EFI_NETWORK_STATISTICS  *Statistics OPTIONAL,
+  IN  UINTN                   MacBaseAddress
+  )
+{
+  PHY_COUNTERS    *Counters;
+
+  Counters = &PhyDriver->Counters;
+  PhySampleCounters (PhyDriver, MacBaseAddress);
+
+  if (Statistics != NULL) {
+    EmacMmcGetStatistics (&Counters->Mmc, Statistics);
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: %ld receive errors, %ld idle errors, %d retrains\r\n",
+          Counters->RxErrors, Counters->IdleErrors, PhyDriver->Retrains));
+
+  if (Reset) {
+    Counters->RxErrors = 0;
+    Counters->IdleErrors = 0;
+    EmacMmcClear (&Counters->Mmc);
+    PhyDriver->QualityIdleErrors = 0;
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC_ASSERT ((PHY_TRACE_SIZE & (PHY_TRACE_SIZE - 1)) == 0 && PHY_TRACE_SIZE != 0,
+               "PHY_TRACE_SIZE must be a power of two, the ring index is masked");
+
+STATIC PHY_TRACE_RECORD  mPhyTrace[PHY_TRACE_SIZE];
+STATIC UINT32            mPhyTraceHead;
+STATIC EFI_EVENT         mPhyExitBootEvent;
+
+STATIC CONST CHAR8  *mPhyTraceEventName[] = {
+  "state",
+  "sample",
+  "change",
+  "flap",
+  "query",
+  "mac",
+  "mdio-timeout",
+  "downshift",
+  "idle-errors",
+  "retrain",
+};
+
+/**
+	Add a record to the trace ring, the oldest record is overwritten.
+
+	@param Event			PHY_TRACE_EVENT
+	@param PhyAddr			Phy device physical address
+	@param Reg				Event specific
+	@param Value			Event specific
+**/
+STATIC
+VOID
+PhyTrace (
+  IN UINT8    Event,
+  IN UINT32   PhyAddr,
+  IN UINT32   Reg,
+  IN UINT32   Value
+  )
+{
+  PHY_TRACE_RECORD  *Record;
+
+  Record = &mPhyTrace[mPhyTraceHead++ & (PHY_TRACE_SIZE - 1)];
+  Record->TimeUs = (UINT32)PhyGetTimeUs ();
+  Record->Event = Event;
+  Record->PhyAddr = (UINT8)PhyAddr;
+  Record->Reg = (UINT16)Reg;
+  Record->Value = Value;
+}
+
+/**
+	Print the trace ring, oldest record first. Called at ExitBootServices with
+	PHY_TRACE_DUMP_AT_EXIT_BOOT, or on demand by a platform shell command.
+**/
+VOID
+EFIAPI
+PhyTraceDump (
+  VOID
+  )
+{
+  UINT32            Index;
+  UINT32            First;
+  PHY_TRACE_RECORD  *Record;
+
+  First = (mPhyTraceHead > PHY_TRACE_SIZE) ? mPhyTraceHead - PHY_TRACE_SIZE : 0;
+  DEBUG ((DEBUG_INFO, "SNP:PHY: trace, %d records\r\n", mPhyTraceHead - First));
+  for (Index = First; Index != mPhyTraceHead; Index++) {
+    Record = &mPhyTrace[Index & (PHY_TRACE_SIZE - 1)];
+    DEBUG ((DEBUG_INFO, "SNP:PHY: %10u us %-12a addr %02x reg %04x value %08x\r\n",
+            Record->TimeUs,
+            (Record->Event < PhyTraceEventMax) ? mPhyTraceEventName[Record->Event] : "?",
+            Record->PhyAddr, Record->Reg, Record->Value));
+  }
+}
+
+/**
+	ExitBootServices notification, hand every PHY over on its default page and
+	dump the trace ring if PHY_TRACE_DUMP_AT_EXIT_BOOT is set.
+
+	@param Event				The event
+	@param Context				Unused
+**/
+STATIC
+VOID
+EFIAPI
+PhyExitBootNotify (
+  IN EFI_EVENT    Event,
+  IN VOID         *Context
+  )
+{
+  UINTN    Index;
+
+  for (Index = 0; Index < PHY_INSTANCE_MAX; Index++) {
+    if (mPhyInstances[Index] != NULL) {
+      PhyRestoreDefaultPage (mPhyInstances[Index], mPhyInstances[Index]->MacBaseAddress);
+    }
+  }
+
+  if (PHY_TRACE_DUMP_AT_EXIT_BOOT) {
+    PhyTraceDump ();
+  }
+}
+
+/**
+	Register the ExitBootServices notification, once for all phy instances.
+**/
+STATIC
+VOID
+PhyRegisterExitBoot (
+  VOID
+  )
+{
+  if (mPhyExitBootEvent != NULL) {
+    return;
+  }
+
+  if (EFI_ERROR (gBS->CreateEvent (EVT_SIGNAL_EXIT_BOOT_SERVICES, TPL_CALLBACK,
+                   PhyExitBootNotify, NULL, &mPhyExitBootEvent))) {
+    mPhyExitBootEvent = NULL;
+  }
 }
 
 /**
 	Function to update the media state.
-	Read the link state,compare the PhyOldLink state and PhyCurrentLink state,if the state is changed,
-	update the media link state.And if the state is changed to link-up,read the phy capability and
-	config adjust.
+	Return at once with the last sampled link state in PhyCurrentLink. The PHY is
+	sampled and, on a change to link-up, the phy capability is read and the GMAC
+	is adjusted at most once per poll interval, see PhySampleLink.
 
 	@param PhyDriver		  A point to Phy dirver structure
 	@param MacBaseAddress 	  GMAC register base address
 
-	@retval EFI_SUCCESS		  link-up
-	@retval EFI_TIMEOUT		  link-down
+	@retval EFI_SUCCESS		  The media state is up to date.
+	@retval other			  The PHY could not be read.
 **/
 EFI_STATUS
 EFIAPI
@@ -886,69 +4984,11 @@ UpdateMediaState(
 
 )
 {
-	UINT32	   Speed;
-	UINT32	   Duplex;
-	EFI_STATUS   Status = EFI_SUCCESS;
-	UINT32 PhyBasicStatus;
-	UINT32 linkStatus;
-	UINTN         TimeOut;
-	UINT32	Data32;
-	UINT32	ANState;
-
-	Status = EFI_SUCCESS;
-	Speed = SPEED_10;
-	Duplex = DUPLEX_HALF;
-
-	Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &PhyBasicStatus, MacBaseAddress);
-	if (EFI_ERROR (Status)) {
-	  return Status;
-	}
-	if (PhyBasicStatus & PHYSTS_LINK_STS) {
-		linkStatus = LINK_UP;
-    }
-	else{
-		linkStatus = LINK_DOWN;
-	}
-	if(linkStatus == PhyDriver->PhyOldLink){
-		PhyDriver->PhyCurrentLink = linkStatus;
-		PhyDriver->PhyOldLink = PhyDriver->PhyCurrentLink;
-		return EFI_SUCCESS;
-	}
-	else{
-		PhyDriver->PhyCurrentLink = linkStatus;
-	   PhyDriver->PhyOldLink = PhyDriver->PhyCurrentLink;
+	// Bring-up is still running from the timer, the media state is unchanged
+	if (PhyLinkBringUpPending (PhyDriver)) {
+	  return EFI_SUCCESS;
 	}
-	if(linkStatus == LINK_UP){
-		// Wait until autonego process has completed
-		TimeOut = 0;
-		ANState = 0;
-		do {
-			// Read PHY_BASIC_STATUS register from PHY
-			Status = PhyRead (PhyDriver->PhyAddr, PHY_BASIC_STATUS, &Data32, MacBaseAddress);
-			if (EFI_ERROR(Status)) {
-			  return Status;
-			}
-			// Wait until PHYSTS_AUTO_COMP become one
-			if (Data32 & PHYSTS_AUTO_COMP) {
-			  DEBUG ((DEBUG_INFO, "SNP:PHY: Auto Negotiation completed\r\n"));
-			  ANState = 1;
-			  break;
-			}
-			MicroSecondDelay (1);
-		} while (TimeOut++ < 10000);
-		if (ANState == 0) {
-			DEBUG ((DEBUG_INFO, "SNP:PHY: Error! Auto Negotiation timeout\n"));
-			Status =  EFI_TIMEOUT;
-		}
-		else{
-			PhyDriver->PhyCurrentLink = linkStatus;
-			DEBUG((EFI_D_INFO,"Speed and Duplex config!\n"));
-			PhyReadCapability (PhyDriver, &Speed, &Duplex, MacBaseAddress);
-    		EmacConfigAdjust (Speed, Duplex, MacBaseAddress);
-			Status = EFI_SUCCESS;
-		}
 
-	}
-	return Status;
+	return PhySampleLink (PhyDriver, MacBaseAddress);
 }
 
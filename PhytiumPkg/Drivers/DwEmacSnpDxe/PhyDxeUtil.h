@@ -17,14 +17,211 @@
 #ifndef _PHY_DXE_H__
 #define _PHY_DXE_H__
 
-// #define PHY_AR8035
-#define PHY_RTL8211F
+#include <Protocol/SimpleNetwork.h>
 
+#include "EmacDxeLinkUtil.h"
+
+#define PHY_SHADOW_REG_NUM                    16
+
+typedef struct _PHY_DRIVER PHY_DRIVER;
+
+/**
+  PHY specific configuration, run after the soft reset and before AN is started.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *PHY_OPS_CONFIG) (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  );
+
+/**
+  Check that the PHY specific configuration is already in effect, used to keep
+  a link established before this boot.
+**/
+typedef
+BOOLEAN
+(EFIAPI *PHY_OPS_CHECK_CONFIG) (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  );
+
+/**
+  Read the link state and the resolved speed and duplex, in as few MDIO reads
+  as the PHY allows. Speed and Duplex are only valid with Link == LINK_UP.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *PHY_OPS_READ_STATUS) (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  );
+
+/**
+  Enable the link-change interrupts of the PHY.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *PHY_OPS_ENABLE_INTERRUPT) (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  );
+
+/**
+  Read and clear the latched link-change interrupt status of the PHY.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *PHY_OPS_READ_INTERRUPT) (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Events,
+  IN  UINTN        MacBaseAddress
+  );
+
+//
+// PHY init script operations, run by PhyRunScript
+//
+typedef enum {
+  PhyScriptWrite,                 // Reg = Value
+  PhyScriptModify,                // Reg = (Reg & ~Mask) | Value
+  PhyScriptPage,                  // Select register page Value
+  PhyScriptMmdWrite,              // MMD Dev register Reg = Value
+  PhyScriptPoll,                  // Wait until (Reg & Mask) == Value, for at most Arg microseconds
+  PhyScriptDelay                  // Wait Arg microseconds
+} PHY_SCRIPT_OP_TYPE;
+
+typedef struct {
+  UINT8     Op;                   // PHY_SCRIPT_OP_TYPE
+  UINT8     Dev;
+  UINT16    Reg;
+  UINT16    Mask;
+  UINT16    Value;
+  UINT32    Arg;
+} PHY_SCRIPT_OP;
+
+#define PHY_SCRIPT_WRITE(Reg, Value)              { PhyScriptWrite, 0, (Reg), 0xFFFF, (Value), 0 }
+#define PHY_SCRIPT_MODIFY(Reg, Mask, Value)       { PhyScriptModify, 0, (Reg), (Mask), (Value), 0 }
+#define PHY_SCRIPT_PAGE(Page)                     { PhyScriptPage, 0, 0, 0, (Page), 0 }
+#define PHY_SCRIPT_MMD_WRITE(Dev, Reg, Value)     { PhyScriptMmdWrite, (Dev), (Reg), 0xFFFF, (Value), 0 }
+#define PHY_SCRIPT_POLL(Reg, Mask, Value, Us)     { PhyScriptPoll, 0, (Reg), (Mask), (Value), (Us) }
+#define PHY_SCRIPT_DELAY(Us)                      { PhyScriptDelay, 0, 0, 0, 0, (Us) }
+
+typedef struct {
+  UINT32    Ops;                  // Script operations run
+  UINT32    Frames;               // MDIO frames issued
+  UINT64    ElapsedUs;
+} PHY_SCRIPT_STATS;
+
+//
+// Per PHY operations, selected at runtime by the PHY_ID1/PHY_ID2 value
+//
 typedef struct {
+  UINT32                    PhyId;          // (PHY_ID1 << 16) | PHY_ID2
+  UINT32                    PhyIdMask;
+  CONST CHAR8               *Name;
+  CONST PHY_SCRIPT_OP       *ConfigScript;  // Optional, run before Config
+  UINTN                     ConfigScriptSize;
+  PHY_OPS_CONFIG            Config;         // Optional
+  PHY_OPS_CHECK_CONFIG      CheckConfig;    // Optional, ConfigScript is checked without it
+  PHY_OPS_READ_STATUS       ReadStatus;
+  PHY_OPS_ENABLE_INTERRUPT  EnableInterrupt;
+  PHY_OPS_READ_INTERRUPT    ReadInterrupt;
+} PHY_OPS;
+
+//
+// Link bring-up state machine, advanced from a periodic timer event:
+// reset -> vendor config -> advertise -> wait link -> wait AN -> adjust MAC
+//
+typedef enum {
+  PhyLinkStateIdle,
+  PhyLinkStateReset,
+  PhyLinkStateVendorConfig,
+  PhyLinkStateAdvertise,
+  PhyLinkStateWaitLink,
+  PhyLinkStateWaitAutoNego,
+  PhyLinkStateAdjustMac,
+  PhyLinkStateLinkUp,             // Bring-up finished with link up
+  PhyLinkStateLinkDown,           // Bring-up finished without link
+  PhyLinkStateError               // Bring-up failed, the PHY did not respond
+} PHY_LINK_STATE;
+
+//
+// MDIO traffic of one PHY, counted by PhyRead/PhyWrite
+//
+typedef struct {
+  UINT64   Reads;
+  UINT64   Writes;
+  UINT64   BusyPolls;                     // GMII busy bit reads while waiting for a frame
+  UINT64   Timeouts;
+} PHY_MDIO_COUNTERS;
+
+//
+// One operation of an MDIO batch, see PhyMdioRunBatch
+//
+typedef struct {
+  UINT8    Op;                            // PHY_MDIO_OP_xxx
+  UINT8    Reg;
+  UINT16   Data;                          // Data to write, or read data
+} PHY_MDIO_OP;
+
+//
+// Error and traffic counters of a port, 64-bit totals since the last reset
+//
+typedef struct {
+  UINT64              RxErrors;           // PHY receive symbol errors
+  UINT16              RxErrorLast;        // Last raw value of a roll-over PHY counter, 0 after a PHY reset
+  UINT64              IdleErrors;         // 1000BASE-T idle errors
+  EMAC_MMC_COUNTERS   Mmc;                // GMAC traffic counters
+  UINT64              SampleTime;         // Last sample, in microseconds
+} PHY_COUNTERS;
+
+struct _PHY_DRIVER {
   UINT32 PhyAddr;
   UINT32 PhyCurrentLink;
   UINT32 PhyOldLink;
-} PHY_DRIVER;
+  UINT32 QueryLink;                       // Link last reported to SNP, MAX_UINT32 before the first query
+  UINT16 ShadowReg[PHY_SHADOW_REG_NUM];   // Write-through copy of static PHY registers
+  UINT32 ShadowValid;                     // Bitmap of valid ShadowReg entries
+  UINTN           MacBaseAddress;
+  PHY_LINK_STATE  LinkState;
+  EFI_EVENT       LinkTimer;
+  UINT64          PhaseStart;             // Start of the current state, in microseconds
+  UINT64          NextPollTime;           // Next register poll of the current state, in microseconds
+  UINT32          PollBackoff;            // Current delay between polls of the current state, in microseconds
+  UINT64          LastPollTime;           // Last link sample, in microseconds
+  UINT32          PollInterval;           // Current link sample interval, in microseconds
+  UINT32          IrqMode;                // PHY_LINK_IRQ_xxx
+  volatile BOOLEAN IrqPending;            // Set by PhySignalLinkInterrupt in PHY_LINK_IRQ_GPIO mode
+  UINT32          PhyId;                  // (PHY_ID1 << 16) | PHY_ID2
+  CONST PHY_OPS   *Ops;
+  UINT32          CurrentPage;            // RTL8211F page left selected, PHY_PAGE_UNKNOWN after reset
+  BOOLEAN         ResolvedValid;          // ResolvedSpeed/ResolvedDuplex hold the current link
+  UINT32          ResolvedSpeed;          // Speed resolved from the ability registers
+  UINT32          ResolvedDuplex;
+  PHY_MDIO_COUNTERS MdioCounters;
+  UINT16          EeeCapability;          // PHY_EEE_xxx speeds of the PHY, 0 without EEE
+  BOOLEAN         EeeActive;              // EEE resolved on the current link
+  BOOLEAN         PauseTx;                // PAUSE frames sent, as programmed in the GMAC
+  BOOLEAN         PauseRx;                // PAUSE frames honored, as programmed in the GMAC
+  BOOLEAN         MacConfigValid;         // MacSpeed/MacDuplex/PauseTx/PauseRx hold the GMAC config, cleared on link down
+  UINT32          MacSpeed;
+  UINT32          MacDuplex;
+  UINT8           LinkMode;               // PHY_LINK_MODE_xxx
+  UINT32          SavedLink;              // PHY_LINK_PACK value in the PhyLink variable, 0 if none
+  BOOLEAN         LinkPending;            // PendingLink seen, waiting for PHY_LINK_DEBOUNCE_US
+  UINT32          PendingLink;
+  UINT64          PendingSince;           // First sample of PendingLink, in microseconds
+  UINT64          QualityCheckTime;       // Last link quality check, in microseconds
+  UINT32          Retrains;               // Auto-negotiation restarts by the link quality monitor
+  BOOLEAN         QualityExhausted;       // Retrain budget used up, the link is no longer checked
+  UINT64          QualityIdleErrors;      // Counters.IdleErrors at the last link quality check
+  PHY_COUNTERS    Counters;
+  UINT16          RecentRead[PHY_SHADOW_REG_NUM];     // Last read of registers 0-15
+  UINT64          RecentReadTime[PHY_SHADOW_REG_NUM]; // Time of RecentRead in microseconds, 0 if none
+};
 
 
 //
@@ -46,15 +243,26 @@ typedef struct {
 #define PHY_INT_MASK                          30
 #define PHY_SPECIAL_PHY_CTLR                  31
 
+// Registers served from the PHY_DRIVER shadow copy, everything else always hits MDIO
+#define PHY_SHADOW_REG_MASK                   ((1 << PHY_BASIC_CTRL) | (1 << PHY_ID1) | (1 << PHY_ID2) | \
+                                               (1 << PHY_AUTO_NEG_ADVERT) | (1 << PHY_1000BASE_T_CONTROL))
+
+// PHY_INT_SRC/PHY_INT_MASK bits
+#define PHYINT_LINK_DOWN                      BIT4            // Link down
+#define PHYINT_AUTO_COMP                      BIT6            // Auto-Negotiation complete
+
 // PHY control register bits
+#define PHYCTRL_SPEED_MSB                     BIT6            // Link Speed Selection MSB
 #define PHYCTRL_COLL_TEST                     BIT7            // Collision test enable
 #define PHYCTRL_DUPLEX_MODE                   BIT8            // Set Duplex Mode
 #define PHYCTRL_RST_AUTO                      BIT9            // Restart Auto-Negotiation of Link abilities
+#define PHYCTRL_ISOLATE                       BIT10           // Isolate the PHY from the MII
 #define PHYCTRL_PD                            BIT11           // Power-Down switch
 #define PHYCTRL_AUTO_EN                       BIT12           // Auto-Negotiation Enable
 #define PHYCTRL_SPEED_SEL                     BIT13           // Link Speed Selection
 #define PHYCTRL_LOOPBK                        BIT14           // Set loopback mode
 #define PHYCTRL_RESET                         BIT15           // Do a PHY reset
+#define PHYCTRL_SELF_CLEAR                    (PHYCTRL_RESET | PHYCTRL_RST_AUTO)
 
 // PHY status register bits
 #define PHYSTS_EXT_CAP                        BIT0            // Extended Capabilities Register capability
@@ -76,6 +284,8 @@ typedef struct {
 #define PHYANA_100BASETX                      BIT7             // Advertise 100BASETX capability
 #define PHYANA_100BASETXFD                    BIT8             // Advertise 100 BASETX Full duplex capability
 #define PHYANA_PAUSE_OP_MASK                  (3 << 10)        // Advertise PAUSE frame capability
+#define PHYANA_PAUSE_CAP                      BIT10            // Advertise symmetric PAUSE
+#define PHYANA_PAUSE_ASYM                     BIT11            // Advertise asymmetric PAUSE
 #define PHYANA_REMOTE_FAULT                   BIT13            // Remote fault detected
 
 #define PHYLPA_SLCT                           0x001f           // Same as advertise selector
@@ -99,6 +309,7 @@ typedef struct {
 #define PHYLPA_100                            (LPA_100FULL | LPA_100HALF | LPA_100BASE4)
 
 // 1000BASE-T Status register
+#define PHYLPA_1000_IDLE_ERR_MASK             0x00FF           // Idle error count, cleared on read
 #define PHYLPA_1000FULL                       0x0800           // Link partner 1000BASE-T full duplex
 #define PHYLPA_1000HALF                       0x0400           // Link partner 1000BASE-T half duplex
 
@@ -115,18 +326,113 @@ typedef struct {
 
 // PHY Super Special control/status
 #define PHYSSCS_HCDSPEED_MASK                 (7 << 2)        // Speed indication
+#define PHYSSCS_HCDSPEED_10HD                 (1 << 2)
+#define PHYSSCS_HCDSPEED_100HD                (2 << 2)
+#define PHYSSCS_HCDSPEED_10FD                 (5 << 2)
+#define PHYSSCS_HCDSPEED_100FD                (6 << 2)
 #define PHYSSCS_AUTODONE                      BIT12           // Auto-Negotiation Done
 
 // Flags for PHY reset
-#define PHY_RESET_PMT                         BIT0
-#define PHY_RESET_BCR                         BIT1
-#define PHY_RESET_CHECK_LINK                  BIT2
+#define PHY_RESET_PMT                         BIT0            // Power down and up through PHY_BASIC_CTRL first
+#define PHY_RESET_BCR                         BIT1            // Reset through PHY_BASIC_CTRL
+#define PHY_RESET_CHECK_LINK                  BIT2            // Keep a link that is up with the expected config
+
+// PHY reset strategy, PHY_RESET_xxx. Without PHY_RESET_PMT and PHY_RESET_BCR the
+// PHY is configured as found.
+#ifndef PHY_RESET_MODE
+#define PHY_RESET_MODE                        (PHY_RESET_BCR | PHY_RESET_CHECK_LINK)
+#endif
+#define PHY_RESET_PMT_DELAY_US                1000
+
+// Speed advertisement bits owned by PhyAutoNego
+#define PHY_ADVERTISE_10_100                  (PHYANA_10BASET | PHYANA_10BASETFD | PHYANA_100BASETX | PHYANA_100BASETXFD)
+#define PHY_ADVERTISE_1000                    (PHYADVERTISE_1000FULL | PHYADVERTISE_1000HALF)
+#define PHY_LINK_MODE_CTRL_MASK               (PHYCTRL_AUTO_EN | PHYCTRL_SPEED_SEL | PHYCTRL_SPEED_MSB | PHYCTRL_DUPLEX_MODE)
+
+// Link mode of a port, PHY_LINK_MODE by default, overridden per port by the UINT8
+// variable "PhyMode<MacBaseAddress>". 1000BASE-T needs auto-negotiation, so only
+// 10/100 links can be forced.
+#define PHY_LINK_MODE_AUTO                    0               // Advertise every speed and duplex
+#define PHY_LINK_MODE_AUTO_1000FD             1               // Advertise 1000BASE-T full duplex only
+#define PHY_LINK_MODE_AUTO_FULL_DUPLEX        2               // Advertise full duplex speeds only
+#define PHY_LINK_MODE_FORCE_100FD             3
+#define PHY_LINK_MODE_FORCE_100HD             4
+#define PHY_LINK_MODE_FORCE_10FD              5
+#define PHY_LINK_MODE_FORCE_10HD              6
+#define PHY_LINK_MODE_MAX                     7
+#ifndef PHY_LINK_MODE
+#define PHY_LINK_MODE                         PHY_LINK_MODE_AUTO
+#endif
+#define PHY_LINK_MODE_VARIABLE_NAME           L"PhyMode%lX"
+
+typedef struct {
+  UINT16          Advertise;              // PHY_ADVERTISE_10_100 bits advertised
+  UINT16          GigControl;             // PHY_ADVERTISE_1000 bits advertised
+  UINT16          Control;                // PHY_LINK_MODE_CTRL_MASK bits of PHY_BASIC_CTRL
+  UINT16          Speed;                  // Forced speed
+  UINT8           Duplex;                 // Forced duplex
+} PHY_LINK_MODE_SETTING;
+
+// PAUSE advertisement, PHYANA_PAUSE_xxx. Symmetric and asymmetric by default,
+// resolved per IEEE 802.3 Annex 28B against the link partner.
+#ifndef PHY_PAUSE_ADVERTISE
+#define PHY_PAUSE_ADVERTISE                   (PHYANA_PAUSE_CAP | PHYANA_PAUSE_ASYM)
+#endif
 
 // Flags for auto negotiation
 #define AUTO_NEGOTIATE_COLLISION_TEST         BIT0
 #define AUTO_NEGOTIATE_ADVERTISE_ALL          BIT1
 
 
+// IEEE 802.3 Annex 22D MMD access through clause 22 registers 13/14
+#define PHY_MMD_ACCESS_CTRL                   13
+#define PHY_MMD_ACCESS_DATA                   14
+#define PHY_MMD_FUNC_SHIFT                    14
+#define PHY_MMD_FUNC_ADDRESS                  0x0
+#define PHY_MMD_FUNC_DATA                     0x1
+#define PHY_MMD_FUNC_DATA_POST_INC_RW         0x2
+#define PHY_MMD_FUNC_DATA_POST_INC_W          0x3
+#define PHY_MMD_DEVAD_MASK                    0x1F
+#define PHY_MMD_BLOCK_MAX                     16
+#define PHY_MMD_SETUP_OPS                     3               // MDIO frames to set up an MMD access
+
+// MDIO batches run at PHY_MDIO_BATCH_TPL, above the link timer, so a sequence such
+// as an MMD access or a page select and access is never split by a poll. A poll
+// read of registers 0-15 joins a read of the same register completed within
+// PHY_MDIO_JOIN_US instead of issuing another frame.
+#define PHY_MDIO_OP_READ                      0
+#define PHY_MDIO_OP_WRITE                     1
+#define PHY_MDIO_BATCH_TPL                    TPL_NOTIFY
+#ifndef PHY_MDIO_JOIN_US
+#define PHY_MDIO_JOIN_US                      1000
+#endif
+
+// Energy Efficient Ethernet, IEEE 802.3 clause 45 registers reached through MMD access
+#define PHY_MMD_DEV_PCS                       3
+#define PHY_MMD_DEV_AN                        7
+#define PHY_MMD_PCS_EEE_CAP                   20
+#define PHY_MMD_AN_EEE_ADV                    60
+#define PHY_MMD_AN_EEE_LP_ABILITY             61
+#define PHY_EEE_100BASETX                     BIT1
+#define PHY_EEE_1000BASET                     BIT2
+#define PHY_EEE_MASK                          (PHY_EEE_100BASETX | PHY_EEE_1000BASET)
+
+// EEE policy
+#define PHY_EEE_OFF                           0               // Advertise nothing, LPI stays off
+#define PHY_EEE_ON                            1               // Advertise every EEE speed of the PHY
+#define PHY_EEE_LATENCY                       2               // Advertise speeds waking within PHY_EEE_MAX_WAKE_US
+#ifndef PHY_EEE_POLICY
+#define PHY_EEE_POLICY                        PHY_EEE_OFF
+#endif
+#ifndef PHY_EEE_MAX_WAKE_US
+#define PHY_EEE_MAX_WAKE_US                   20
+#endif
+
+// Wake time from LPI (Tw_sys_tx), LPI entry delay after the link comes up
+#define PHY_EEE_WAKE_1000_US                  17
+#define PHY_EEE_WAKE_100_US                   30
+#define PHY_EEE_LS_TIMER_MS                   1000
+
 // Micrel KSZ9031 Extended registers
 #define PHY_KSZ9031RN_CONTROL_PAD_SKEW_REG    4
 #define PHY_KSZ9031RN_RX_DATA_PAD_SKEW_REG    5
@@ -171,6 +477,36 @@ typedef struct {
 #define MII_CLKRANGE_150_250M                 (0x10)
 #define MII_CLKRANGE_250_300M                 (0x14)
 
+#define MII_CLKRANGE_MASK                     (0x3C)
+
+// Clause 22 MDC limit and frame length, preamble included
+#define MII_MDC_MAX_HZ                        2500000
+#define MII_FRAME_MDC_CYCLES                  64
+
+// MDIO completion timeout, the same for reads and writes
+#define PHY_MDIO_TIMEOUT_US                   1000
+
+// GMAC CSR clock used to pick the MDC divider, 0 if unknown. With an unknown
+// clock PHY_MDC_CALIBRATE times MDIO frames to measure it, otherwise the
+// MII_CLKRANGE_150_250M divider is kept.
+#ifndef PHY_GMAC_CSR_CLOCK_HZ
+#define PHY_GMAC_CSR_CLOCK_HZ                 0
+#endif
+#ifndef PHY_MDC_CALIBRATE
+#define PHY_MDC_CALIBRATE                     FALSE
+#endif
+#define PHY_MDC_CALIBRATE_FRAMES              16
+
+#define PHY_MDIO_BUS_MAX                      4
+#define PHY_INSTANCE_MAX                      4
+
+// GMAC whose MDC/MDIO pins reach the PHYs of every port, 0 when each GMAC
+// drives its own PHY. Boards with a mixed layout call PhyMdioAttach instead.
+// Ports on a shared bus are only detected at the address given to PhyMdioAttach.
+#ifndef PHY_MDIO_SHARED_BUS_BASE
+#define PHY_MDIO_SHARED_BUS_BASE              0
+#endif
+
 #define MIIADDRSHIFT                          (11)
 #define MIIREGSHIFT                           (6)
 #define MII_REGMSK                            (0x1F << 6)
@@ -178,15 +514,274 @@ typedef struct {
 
 // Others
 #define PHY_INVALID_ID                        0xFFFF
+#define PHY_MAX_ADDR                          32
+#define PHY_ADDR_NONE                         0xFF
 #define LINK_UP                               1
 #define LINK_DOWN                             0
 #define PHY_TIMEOUT                           100000
 
+//
+// MDIO bus, driven by one GMAC and shared by every GMAC attached to it
+//
+typedef struct {
+  UINTN    MacBaseAddress;                // GMAC driving MDC/MDIO, 0 for an unused entry
+  UINT32   ClockRange;                    // MII_CLKRANGE_xxx
+  UINT32   CsrClockHz;                    // 0 if unknown
+  UINT64   Frames;                        // MDIO frames issued
+  UINT32   Users;                         // GMACs attached, frames are serialized when above 1
+  BOOLEAN  Scanned;                       // PhyId[] holds a full bus scan
+  UINT32   PresentMask;                   // Addresses known to answer
+  UINT32   ClaimedMask;                   // Addresses owned by a PHY_DRIVER
+  UINT32   PhyId[PHY_MAX_ADDR];
+} PHY_MDIO_BUS;
+
+// Link bring-up state machine timing
+#define PHY_LINK_POLL_PERIOD                  (10 * 1000 * 10)    // 10ms, in 100ns units
+
+// Budget of each bring-up phase, real time from the performance counter.
+// Boards override them from their build options.
+#ifndef PHY_RESET_TIMEOUT_US
+#define PHY_RESET_TIMEOUT_US                  500000
+#endif
+#ifndef PHY_LINK_TIMEOUT_US
+#define PHY_LINK_TIMEOUT_US                   5000000
+#endif
+#ifndef PHY_AUTONEGO_TIMEOUT_US
+#define PHY_AUTONEGO_TIMEOUT_US               5000000
+#endif
+
+// Performance measurement tokens of the bring-up phases, shown by the dp shell command.
+// Records are made against the image handle, ports are told apart by the identifier.
+#define PHY_PERF_MODULE                       "DwEmacSnpDxe"
+#define PHY_PERF_ID(MacBaseAddress)           ((UINT32)(MacBaseAddress))
+#define PHY_PERF_DETECT                       "PhyDetect"
+#define PHY_PERF_RESET                        "PhyReset"
+#define PHY_PERF_VENDOR_CONFIG                "PhyVendorConfig"
+#define PHY_PERF_AUTONEGO                     "PhyAutoNego"
+#define PHY_PERF_LINK_WAIT                    "PhyLinkWait"
+#define PHY_PERF_AUTONEGO_WAIT                "PhyAutoNegoWait"
+#define PHY_PERF_ADJUST_MAC                   "EmacConfigAdjust"
+
+// Back-off between register polls, doubled after every poll that did not
+// see the expected value. Blocking waits use the first pair, the link waits
+// of the state machine the second one.
+#define PHY_POLL_BACKOFF_MIN_US               10
+#define PHY_POLL_BACKOFF_MAX_US               10000
+#define PHY_LINK_POLL_BACKOFF_MIN_US          10000
+#define PHY_LINK_POLL_BACKOFF_MAX_US          40000
+
+// Link sampling by PhyLinkAdjustEmacConfig/UpdateMediaState, the interval
+// doubles while the link is stable and is reset to the minimum on a change
+#ifndef PHY_POLL_INTERVAL_MIN_US
+#define PHY_POLL_INTERVAL_MIN_US              100000
+#endif
+#ifndef PHY_POLL_INTERVAL_MAX_US
+#define PHY_POLL_INTERVAL_MAX_US              1600000
+#endif
+
+// A link transition is reported once the new state held for this long, shorter
+// flaps are absorbed. 0 reports every sampled transition.
+#ifndef PHY_LINK_DEBOUNCE_US
+#define PHY_LINK_DEBOUNCE_US                  300000
+#endif
+
+// Link quality monitor. A downshift, both sides advertise 1000BASE-T but the link
+// resolved slower, or a burst of 1000BASE-T idle errors restarts auto-negotiation,
+// at most PHY_QUALITY_RETRAIN_MAX times per boot.
+#ifndef PHY_QUALITY_MONITOR
+#define PHY_QUALITY_MONITOR                   TRUE
+#endif
+#define PHY_QUALITY_INTERVAL_US               1000000
+#define PHY_QUALITY_IDLE_ERR_BURST            32              // Idle errors per interval
+#define PHY_QUALITY_RETRAIN_MAX               3
+
+// Error counters. The PHY counters are 16 bits, cleared on read or rolling over,
+// the GMAC MMC counters 32 bits and free running; all are folded into 64-bit
+// totals at least once per PHY_COUNTER_INTERVAL_US while the link is polled.
+#define PHY_COUNTER_INTERVAL_US               1000000
+#define PHY_COUNTER_NO_PAGE                   0xFFFFFFFF
+
+typedef struct {
+  UINT32   PhyId;
+  UINT32   PhyIdMask;
+  UINT32   Page;                          // PHY_COUNTER_NO_PAGE for an unpaged register
+  UINT32   Reg;
+  BOOLEAN  RollOver;                      // Read-only and rolling over, else cleared on read
+} PHY_RX_ERROR_COUNTER;
+
+// PHY event trace, a ring of compact records replacing DEBUG prints on hot paths
+#ifndef PHY_TRACE_SIZE
+#define PHY_TRACE_SIZE                        256             // Records, a power of two
+#endif
+#ifndef PHY_TRACE_DUMP_AT_EXIT_BOOT
+#define PHY_TRACE_DUMP_AT_EXIT_BOOT           FALSE
+#endif
+
+typedef enum {
+  PhyTraceState,                  // Reg = new PHY_LINK_STATE
+  PhyTraceLinkSample,             // Reg = speed, Value = (duplex << 8) | link
+  PhyTraceLinkChange,             // Reg = speed, Value = (duplex << 8) | link, reported to SNP
+  PhyTraceLinkFlap,               // Value = link state of the absorbed flap
+  PhyTraceLinkQuery,              // Value = link reported by PhyLinkAdjustEmacConfig
+  PhyTraceMacConfig,              // Reg = speed, Value = (duplex << 8) | pause rx << 1 | pause tx, 0xFFFF if unchanged
+  PhyTraceMdioTimeout,            // Reg = PHY register
+  PhyTraceDownshift,              // Reg = speed, Value = PHY_1000BASE_T_STATUS
+  PhyTraceIdleErrors,             // Value = idle errors in the last interval
+  PhyTraceRetrain,                // Value = retrains so far
+  PhyTraceEventMax
+} PHY_TRACE_EVENT;
+
+typedef struct {
+  UINT32    TimeUs;               // Low 32 bits of the performance counter time
+  UINT8     Event;                // PHY_TRACE_EVENT
+  UINT8     PhyAddr;
+  UINT16    Reg;
+  UINT32    Value;
+} PHY_TRACE_RECORD;
+
+// Link change detection
+#define PHY_LINK_IRQ_NONE                     0               // Poll PHY_BASIC_STATUS
+#define PHY_LINK_IRQ_LATCHED                  1               // Poll the latched PHY interrupt status
+#define PHY_LINK_IRQ_GPIO                     2               // Platform GPIO calls PhySignalLinkInterrupt
+#ifndef PHY_LINK_IRQ_MODE
+#define PHY_LINK_IRQ_MODE                     PHY_LINK_IRQ_NONE
+#endif
+
+// PHY identifiers, (PHY_ID1 << 16) | PHY_ID2
+#define PHY_ID_RTL8211F                       0x001CC916
+#define PHY_ID_AR8035                         0x004DD072
+#define PHY_ID_KSZ9031                        0x00221620
+#define PHY_ID_LAN8720                        0x0007C0F0
+#define PHY_ID_LAN8742                        0x0007C130
+#define PHY_ID_MASK_EXACT                     0xFFFFFFFF
+#define PHY_ID_MASK_NO_REV                    0xFFFFFFF0
+
+#define PHY_PAGE_UNKNOWN                      0xFFFFFFFF
+
+// Last detected PHY address of each GMAC, stored as UINT32 in "PhyAddr<MacBaseAddress>"
+#define PHY_DXE_VARIABLE_GUID \
+  { 0x5b3e1a2c, 0x8d47, 0x4f0e, { 0x9a, 0x61, 0x2c, 0x7d, 0x13, 0xe4, 0x58, 0xb9 } }
+#define PHY_ADDR_VARIABLE_NAME                L"PhyAddr%lX"
+#define PHY_VARIABLE_NAME_SIZE                32
+
+// Last resolved link of each GMAC, stored as UINT32 in "PhyLink<MacBaseAddress>" and
+// programmed into the GMAC before auto-negotiation completes
+#define PHY_LINK_VARIABLE_NAME                L"PhyLink%lX"
+#define PHY_LINK_PACK(Speed, Duplex, PauseTx, PauseRx) \
+  ((UINT32)(Speed) | ((UINT32)(Duplex) << 16) | ((UINT32)(PauseTx) << 24) | ((UINT32)(PauseRx) << 25))
+#define PHY_LINK_SPEED(Link)                  ((Link) & 0xFFFF)
+#define PHY_LINK_DUPLEX(Link)                 (((Link) >> 16) & 0xFF)
+#define PHY_LINK_PAUSE_TX(Link)               ((BOOLEAN)(((Link) >> 24) & 1))
+#define PHY_LINK_PAUSE_RX(Link)               ((BOOLEAN)(((Link) >> 25) & 1))
+#ifndef PHY_LINK_PRECONFIG
+#define PHY_LINK_PRECONFIG                    TRUE
+#endif
+
+//
+// Auto-negotiation started before DXE. A PEI module resets the PHY, writes the
+// advertisement and restarts auto-negotiation as early as possible, then leaves
+// one PHY_AUTONEGO_HOB per GMAC so PhyDxeInitialization adopts the negotiation
+// in progress instead of restarting it. PhyPeiStartAutoNego in PhyPeiUtil.c
+// does all of it with PEI-safe libraries only.
+//
+#define PHY_AUTONEGO_HOB_GUID \
+  { 0x2f6d8a41, 0x37c2, 0x4b95, { 0xb1, 0x0e, 0x6a, 0x54, 0xd9, 0x83, 0x1c, 0x7f } }
+#define PHY_AUTONEGO_HOB_VERSION              1
+
+#define PHY_HOB_RESET_DONE                    BIT0        // Soft reset completed
+#define PHY_HOB_VENDOR_CONFIG                 BIT1        // Vendor config of the PHY applied
+#define PHY_HOB_AUTONEGO                      BIT2        // Advertisement written, auto-negotiation restarted
+
+typedef struct {
+  UINT32   Version;                       // PHY_AUTONEGO_HOB_VERSION
+  UINT32   Flags;                         // PHY_HOB_xxx
+  UINT64   MacBaseAddress;
+  UINT32   PhyAddr;
+  UINT32   PhyId;                         // (PHY_ID1 << 16) | PHY_ID2
+  UINT64   AutoNegoStartNs;               // GetTimeInNanoSecond (GetPerformanceCounter ()) at restart
+  UINT16   Advertise;                     // PHY_AUTO_NEG_ADVERT written
+  UINT16   GigControl;                    // PHY_1000BASE_T_CONTROL written
+  UINT32   Reserved;
+} PHY_AUTONEGO_HOB;
+
+// MII_CLKRANGE_xxx of the MDIO bus before DXE, the CSR clock is not calibrated there
+#ifndef PHY_PEI_MDIO_CLOCK_RANGE
+#define PHY_PEI_MDIO_CLOCK_RANGE              MII_CLKRANGE_150_250M
+#endif
+
+/**
+  PHY specific configuration run by PhyPeiStartAutoNego between the soft reset
+  and the auto-negotiation restart, with PhyPeiRead/PhyPeiWrite.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *PHY_PEI_CONFIG)(
+  IN  UINTN        MdioBaseAddress,
+  IN  UINT32       PhyAddr
+  );
+
 // RTL8211F
+#define RTL8211F_DEFAULT_PAGE                 0
 #define LCR_PAGE   0xd04
 #define LCR_REG    16
 #define EEELCR_REG     17
 
+#define RTL8211F_INER_PAGE                    0xa42
+#define RTL8211F_INER_REG                     18
+#define RTL8211F_INSR_PAGE                    0xa43           // Also mapped on the default page
+#define RTL8211F_INSR_REG                     29
+#define RTL8211F_INT_AUTO_COMP                BIT3
+#define RTL8211F_INT_LINK_CHG                 BIT4
+
+// RTL8211F PHY specific status (PHYSR)
+#define RTL8211F_PHYSR_PAGE                   0xa43
+#define RTL8211F_PHYSR_REG                    26
+#define RTL8211F_PHYSR_LINK                   BIT2
+#define RTL8211F_PHYSR_DUPLEX                 BIT3
+#define RTL8211F_PHYSR_SPEED_MASK             (3 << 4)
+#define RTL8211F_PHYSR_SPEED_100              (1 << 4)
+#define RTL8211F_PHYSR_SPEED_1000             (2 << 4)
+
+// AR8035 interrupt enable/status, same bit layout
+#define AR8035_INT_ENABLE_REG                 0x12
+#define AR8035_INT_STATUS_REG                 0x13
+#define AR8035_INT_LINK_UP                    BIT10
+#define AR8035_INT_LINK_DOWN                  BIT11
+
+// AR8035 PHY specific status
+#define AR8035_SPECIFIC_STATUS_REG            0x11
+#define AR8035_SS_LINK                        BIT10
+#define AR8035_SS_RESOLVED                    BIT11
+#define AR8035_SS_DUPLEX                      BIT13
+#define AR8035_SS_SPEED_MASK                  (3 << 14)
+#define AR8035_SS_SPEED_100                   (1 << 14)
+#define AR8035_SS_SPEED_1000                  (2 << 14)
+
+// AR8035 debug register access
+#define AR8035_DEBUG_ADDR_REG                 0x1d
+#define AR8035_DEBUG_DATA_REG                 0x1e
+#define AR8035_DEBUG_HIB_CTRL                 0x0b
+#define AR8035_DEBUG_HIB_EN                   BIT15
+
+// KSZ9031 receive symbol error counter
+#define PHY_KSZ9031RN_RXER_CNT_REG            0x15
+
+// LAN87xx symbol error counter
+#define LAN87XX_SYMBOL_ERR_CNT_REG            26
+
+// KSZ9031 interrupt control/status, enables in the high byte
+#define PHY_KSZ9031RN_INT_CTRL_REG            0x1b
+#define PHY_KSZ9031RN_INT_LINK_UP             BIT0
+#define PHY_KSZ9031RN_INT_LINK_DOWN           BIT2
+#define PHY_KSZ9031RN_INT_ENABLE_SHIFT        8
+
+// KSZ9031 PHY control, resolved speed and duplex
+#define PHY_KSZ9031RN_PHY_CTRL_REG            0x1f
+#define PHY_KSZ9031RN_PHY_CTRL_DUPLEX         BIT3
+#define PHY_KSZ9031RN_PHY_CTRL_SPEED_10       BIT4
+#define PHY_KSZ9031RN_PHY_CTRL_SPEED_100      BIT5
+#define PHY_KSZ9031RN_PHY_CTRL_SPEED_1000     BIT6
+
 EFI_STATUS
 EFIAPI
 PhyDxeInitialization (
@@ -208,6 +803,32 @@ PhyConfig (
   IN  UINTN          MacBaseAddress
   );
 
+EFI_STATUS
+EFIAPI
+PhyVendorConfig (
+  IN  PHY_DRIVER     *PhyDriver,
+  IN  UINTN          MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyStartLinkBringUp (
+  IN  PHY_DRIVER     *PhyDriver,
+  IN  UINTN          MacBaseAddress
+  );
+
+VOID
+EFIAPI
+PhyStopLinkBringUp (
+  IN  PHY_DRIVER     *PhyDriver
+  );
+
+PHY_LINK_STATE
+EFIAPI
+PhyGetLinkState (
+  IN  PHY_DRIVER     *PhyDriver
+  );
+
 EFI_STATUS
 EFIAPI
 PhySoftReset (
@@ -219,9 +840,26 @@ EFI_STATUS
 EFIAPI
 PhyReadId (
   IN  UINT32        PhyAddr,
+  OUT UINT32        *PhyId OPTIONAL,
   IN  UINTN         MacBaseAddress
   );
 
+CONST PHY_OPS *
+EFIAPI
+PhyFindOps (
+  IN  UINT32        PhyId
+  );
+
+EFI_STATUS
+EFIAPI
+PhyReadStatus (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Link,
+  OUT UINT32       *Speed,
+  OUT UINT32       *Duplex,
+  IN  UINTN        MacBaseAddress
+  );
+
 VOID
 EFIAPI
 PhyConfigSkew (
@@ -305,6 +943,226 @@ PhyWrite (
   IN  UINTN        MacBaseAddress
   );
 
+EFI_STATUS
+EFIAPI
+PhyPagedRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Page,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyPagedWrite (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Page,
+  IN  UINT32       Reg,
+  IN  UINT32       Data,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyEnableLinkInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyReadLinkInterrupt (
+  IN  PHY_DRIVER   *PhyDriver,
+  OUT UINT32       *Events,
+  IN  UINTN        MacBaseAddress
+  );
+
+VOID
+EFIAPI
+PhySignalLinkInterrupt (
+  IN  PHY_DRIVER   *PhyDriver
+  );
+
+BOOLEAN
+EFIAPI
+PhyCheckScript (
+  IN  PHY_DRIVER           *PhyDriver,
+  IN  CONST PHY_SCRIPT_OP  *Script,
+  IN  UINTN                Count,
+  IN  UINTN                MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyRunScript (
+  IN  PHY_DRIVER           *PhyDriver,
+  IN  CONST CHAR8          *Name,
+  IN  CONST PHY_SCRIPT_OP  *Script,
+  IN  UINTN                Count,
+  IN  UINTN                MacBaseAddress,
+  OUT PHY_SCRIPT_STATS     *Stats OPTIONAL
+  );
+
+UINT64
+EFIAPI
+PhyMdioGetFrameCount (
+  IN  UINTN        MacBaseAddress
+  );
+
+VOID
+EFIAPI
+PhyTraceDump (
+  VOID
+  );
+
+EFI_STATUS
+EFIAPI
+PhyCollectStatistics (
+  IN  PHY_DRIVER              *PhyDriver,
+  IN  BOOLEAN                 Reset,
+  OUT EFI_NETWORK_STATISTICS  *Statistics OPTIONAL,
+  IN  UINTN                   MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyPeiRead (
+  IN  UINTN        MdioBaseAddress,
+  IN  UINT32       PhyAddr,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data
+  );
+
+EFI_STATUS
+EFIAPI
+PhyPeiWrite (
+  IN  UINTN        MdioBaseAddress,
+  IN  UINT32       PhyAddr,
+  IN  UINT32       Reg,
+  IN  UINT32       Data
+  );
+
+EFI_STATUS
+EFIAPI
+PhyPeiStartAutoNego (
+  IN  UINTN            MacBaseAddress,
+  IN  UINTN            MdioBaseAddress,
+  IN  UINT32           PhyAddr,
+  IN  PHY_PEI_CONFIG   Config OPTIONAL
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMdioAttach (
+  IN  UINTN        MacBaseAddress,
+  IN  UINTN        MdioBaseAddress,
+  IN  UINT32       PhyAddr
+  );
+
+VOID
+EFIAPI
+PhyEmacReinitialized (
+  IN  PHY_DRIVER   *PhyDriver
+  );
+
+VOID
+EFIAPI
+PhyDxeRelease (
+  IN  PHY_DRIVER   *PhyDriver
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMdioConfigure (
+  IN  UINTN        MacBaseAddress,
+  IN  UINT32       CsrClockHz
+  );
+
+EFI_STATUS
+EFIAPI
+PhyShadowRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyShadowWrite (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Reg,
+  IN  UINT32       Data,
+  IN  UINTN        MacBaseAddress
+  );
+
+VOID
+EFIAPI
+PhyShadowInvalidate (
+  IN  PHY_DRIVER   *PhyDriver
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMdioRunBatch (
+  IN     PHY_DRIVER   *PhyDriver,
+  IN OUT PHY_MDIO_OP  *Ops,
+  IN     UINTN        Count,
+  IN     UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMdioPollRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMmdRead (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMmdWrite (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  IN  UINT32       Data,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMmdReadBlock (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  IN  UINTN        Count,
+  OUT UINT16       *Buffer,
+  IN  UINTN        MacBaseAddress
+  );
+
+EFI_STATUS
+EFIAPI
+PhyMmdWriteBlock (
+  IN  PHY_DRIVER   *PhyDriver,
+  IN  UINT32       DevAddr,
+  IN  UINT32       Reg,
+  IN  UINTN        Count,
+  IN  CONST UINT16 *Buffer,
+  IN  UINTN        MacBaseAddress
+  );
+
 EFI_STATUS
 EFIAPI
 Phy9031ExtendedWrite (
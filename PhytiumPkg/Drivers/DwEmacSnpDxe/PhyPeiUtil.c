@@ -0,0 +1,270 @@
+/** @file
+
+  Copyright (c) 2011 - 2019, Intel Corporaton. All rights reserved.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Auto-negotiation kick-off before DXE. Only PEI-safe libraries are used here,
+  so a board PEIM can build this file next to its own sources.
+
+**/
+
+
+#include "PhyDxeUtil.h"
+#include "EmacDxeUtil.h"
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/IoLib.h>
+#include <Library/TimerLib.h>
+
+STATIC EFI_GUID  mPhyPeiAutoNegoHobGuid = PHY_AUTONEGO_HOB_GUID;
+
+/**
+	Current time in microseconds, from the performance counter.
+**/
+STATIC
+UINT64
+PhyPeiGetTimeUs (
+  VOID
+  )
+{
+  return DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter ()), 1000);
+}
+
+/**
+	Run one MDIO frame with PHY_PEI_MDIO_CLOCK_RANGE.
+
+	@param MdioBaseAddress 	Register base address of the GMAC driving MDC/MDIO
+	@param PhyAddr			Phy device physical address
+	@param Reg 				Phy register
+	@param Write			TRUE for a write frame
+	@param Data				Data to write, or read data
+
+	@retval EFI_SUCCESS	    The frame completed.
+	@retval EFI_TIMEOUT	    The frame did not complete within PHY_MDIO_TIMEOUT_US.
+**/
+STATIC
+EFI_STATUS
+PhyPeiMdioTransfer (
+  IN     UINTN    MdioBaseAddress,
+  IN     UINT32   PhyAddr,
+  IN     UINT32   Reg,
+  IN     BOOLEAN  Write,
+  IN OUT UINT32   *Data
+  )
+{
+  UINT32    MiiConfig;
+  UINT64    Start;
+
+  MiiConfig = ((PhyAddr << MIIADDRSHIFT) & MII_ADDRMSK) |
+              ((Reg << MIIREGSHIFT) & MII_REGMSK) |
+               (PHY_PEI_MDIO_CLOCK_RANGE & MII_CLKRANGE_MASK) |
+               MII_BUSY;
+
+  if (Write) {
+    MmioWrite32 (MdioBaseAddress + DW_EMAC_GMACGRP_GMII_DATA_OFST, (*Data & 0xFFFF));
+    MiiConfig |= MII_WRITE;
+  }
+  MmioWrite32 (MdioBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST, MiiConfig);
+
+  Start = PhyPeiGetTimeUs ();
+  while (DW_EMAC_GMACGRP_GMII_ADDRESS_GB_GET (MmioRead32 (MdioBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST))) {
+    if (PhyPeiGetTimeUs () - Start >= PHY_MDIO_TIMEOUT_US) {
+      if (DW_EMAC_GMACGRP_GMII_ADDRESS_GB_GET (MmioRead32 (MdioBaseAddress + DW_EMAC_GMACGRP_GMII_ADDRESS_OFST))) {
+        DEBUG ((DEBUG_INFO, "SNP:PHY: MDIO busy bit timeout\r\n"));
+        return EFI_TIMEOUT;
+      }
+      break;
+    }
+  }
+
+  if (!Write) {
+    *Data = DW_EMAC_GMACGRP_GMII_DATA_GD_GET (MmioRead32 (MdioBaseAddress + DW_EMAC_GMACGRP_GMII_DATA_OFST));
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+	Read a phy register before DXE.
+
+	@param MdioBaseAddress 	Register base address of the GMAC driving MDC/MDIO
+	@param PhyAddr			Phy device physical address
+	@param Reg 				Phy register
+	@param Data				Read data
+
+	@retval EFI_SUCCESS	    The register was read.
+	@retval EFI_TIMEOUT	    The MDIO frame did not complete.
+**/
+EFI_STATUS
+EFIAPI
+PhyPeiRead (
+  IN  UINTN        MdioBaseAddress,
+  IN  UINT32       PhyAddr,
+  IN  UINT32       Reg,
+  OUT UINT32       *Data
+  )
+{
+  return PhyPeiMdioTransfer (MdioBaseAddress, PhyAddr, Reg, FALSE, Data);
+}
+
+/**
+	Write a phy register before DXE.
+
+	@param MdioBaseAddress 	Register base address of the GMAC driving MDC/MDIO
+	@param PhyAddr			Phy device physical address
+	@param Reg 				Phy register
+	@param Data				Data to write
+
+	@retval EFI_SUCCESS	    The register was written.
+	@retval EFI_TIMEOUT	    The MDIO frame did not complete.
+**/
+EFI_STATUS
+EFIAPI
+PhyPeiWrite (
+  IN  UINTN        MdioBaseAddress,
+  IN  UINT32       PhyAddr,
+  IN  UINT32       Reg,
+  IN  UINT32       Data
+  )
+{
+  return PhyPeiMdioTransfer (MdioBaseAddress, PhyAddr, Reg, TRUE, &Data);
+}
+
+/**
+	Reset a phy, advertise PHY_LINK_MODE and restart auto-negotiation, then
+	leave a PHY_AUTONEGO_HOB so PhyDxeInitialization adopts the negotiation.
+	1.check a PHY answers at PhyAddr
+	2.soft reset through PHY_BASIC_CTRL
+	3.run the PHY specific configuration, if any
+	4.write the advertisement of PHY_LINK_MODE and restart auto-negotiation
+	5.build the HOB with the restart time
+	A PHY with a vendor config in DXE is only adopted when Config applied it.
+
+	@param MacBaseAddress 		GMAC register base address
+	@param MdioBaseAddress 		Register base address of the GMAC driving MDC/MDIO
+	@param PhyAddr				Phy device physical address
+	@param Config				PHY specific configuration, optional
+
+	@retval EFI_SUCCESS		    Auto-negotiation is running and the HOB is built.
+	@retval EFI_UNSUPPORTED	    PHY_LINK_MODE forces the link.
+	@retval EFI_NOT_FOUND	    No PHY answers at PhyAddr.
+	@retval EFI_TIMEOUT	        The soft reset did not complete.
+	@retval EFI_DEVICE_ERROR	An MDIO frame failed.
+	@retval EFI_OUT_OF_RESOURCES	The HOB could not be built.
+**/
+EFI_STATUS
+EFIAPI
+PhyPeiStartAutoNego (
+  IN  UINTN            MacBaseAddress,
+  IN  UINTN            MdioBaseAddress,
+  IN  UINT32           PhyAddr,
+  IN  PHY_PEI_CONFIG   Config OPTIONAL
+  )
+{
+  PHY_AUTONEGO_HOB  Hob;
+  UINT32            Id1;
+  UINT32            Id2;
+  UINT32            Control;
+  UINT32            Advertise;
+  UINT32            GigControl;
+  UINT32            Wanted;
+  UINT32            WantedGig;
+  UINT64            Start;
+  EFI_STATUS        Status;
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: %a ()\r\n", __FUNCTION__));
+
+  switch (PHY_LINK_MODE) {
+  case PHY_LINK_MODE_AUTO:
+    Wanted = PHY_ADVERTISE_10_100;
+    WantedGig = PHY_ADVERTISE_1000;
+    break;
+  case PHY_LINK_MODE_AUTO_1000FD:
+    Wanted = 0;
+    WantedGig = PHYADVERTISE_1000FULL;
+    break;
+  case PHY_LINK_MODE_AUTO_FULL_DUPLEX:
+    Wanted = PHYANA_10BASETFD | PHYANA_100BASETXFD;
+    WantedGig = PHYADVERTISE_1000FULL;
+    break;
+  default:
+    return EFI_UNSUPPORTED;
+  }
+
+  if (PhyAddr >= PHY_MAX_ADDR ||
+      EFI_ERROR (PhyPeiRead (MdioBaseAddress, PhyAddr, PHY_ID1, &Id1)) ||
+      EFI_ERROR (PhyPeiRead (MdioBaseAddress, PhyAddr, PHY_ID2, &Id2)) ||
+      Id1 == PHY_INVALID_ID || Id2 == PHY_INVALID_ID || (Id1 == 0 && Id2 == 0)) {
+    DEBUG ((DEBUG_INFO, "SNP:PHY: No PHY at address 0x%02X\r\n", PhyAddr));
+    return EFI_NOT_FOUND;
+  }
+
+  ZeroMem (&Hob, sizeof (Hob));
+  Hob.Version = PHY_AUTONEGO_HOB_VERSION;
+  Hob.MacBaseAddress = MacBaseAddress;
+  Hob.PhyAddr = PhyAddr;
+  Hob.PhyId = (Id1 << 16) | Id2;
+
+  // Soft reset
+  if (EFI_ERROR (PhyPeiWrite (MdioBaseAddress, PhyAddr, PHY_BASIC_CTRL, PHYCTRL_RESET))) {
+    return EFI_DEVICE_ERROR;
+  }
+  Start = PhyPeiGetTimeUs ();
+  do {
+    MicroSecondDelay (PHY_POLL_BACKOFF_MAX_US);
+    if (EFI_ERROR (PhyPeiRead (MdioBaseAddress, PhyAddr, PHY_BASIC_CTRL, &Control))) {
+      return EFI_DEVICE_ERROR;
+    }
+    if ((Control & PHYCTRL_RESET) == 0) {
+      break;
+    }
+  } while (PhyPeiGetTimeUs () - Start < PHY_RESET_TIMEOUT_US);
+  if ((Control & PHYCTRL_RESET) != 0) {
+    DEBUG ((DEBUG_ERROR, "SNP:PHY: PHY reset timeout\r\n"));
+    return EFI_TIMEOUT;
+  }
+  Hob.Flags |= PHY_HOB_RESET_DONE;
+
+  if (Config != NULL) {
+    Status = Config (MdioBaseAddress, PhyAddr);
+    if (!EFI_ERROR (Status)) {
+      Hob.Flags |= PHY_HOB_VENDOR_CONFIG;
+    } else {
+      DEBUG ((DEBUG_WARN, "SNP:PHY: PHY config failed - %r\r\n", Status));
+    }
+  }
+
+  // Advertisement of the link mode and the PAUSE capabilities
+  if (EFI_ERROR (PhyPeiRead (MdioBaseAddress, PhyAddr, PHY_AUTO_NEG_ADVERT, &Advertise)) ||
+      EFI_ERROR (PhyPeiRead (MdioBaseAddress, PhyAddr, PHY_1000BASE_T_CONTROL, &GigControl))) {
+    return EFI_DEVICE_ERROR;
+  }
+  Advertise = (Advertise & ~(PHY_ADVERTISE_10_100 | PHYANA_PAUSE_OP_MASK)) | Wanted | PHY_PAUSE_ADVERTISE;
+  GigControl = (GigControl & ~PHY_ADVERTISE_1000) | WantedGig;
+  if (EFI_ERROR (PhyPeiWrite (MdioBaseAddress, PhyAddr, PHY_AUTO_NEG_ADVERT, Advertise)) ||
+      EFI_ERROR (PhyPeiWrite (MdioBaseAddress, PhyAddr, PHY_1000BASE_T_CONTROL, GigControl))) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  // Enable and restart Auto-Negotiation
+  if (EFI_ERROR (PhyPeiRead (MdioBaseAddress, PhyAddr, PHY_BASIC_CTRL, &Control)) ||
+      EFI_ERROR (PhyPeiWrite (MdioBaseAddress, PhyAddr, PHY_BASIC_CTRL,
+                              (Control & ~PHY_LINK_MODE_CTRL_MASK) | PHYCTRL_AUTO_EN | PHYCTRL_RST_AUTO))) {
+    return EFI_DEVICE_ERROR;
+  }
+  Hob.AutoNegoStartNs = GetTimeInNanoSecond (GetPerformanceCounter ());
+  Hob.Advertise = (UINT16)Advertise;
+  Hob.GigControl = (UINT16)GigControl;
+  Hob.Flags |= PHY_HOB_AUTONEGO;
+
+  if (BuildGuidDataHob (&mPhyPeiAutoNegoHobGuid, &Hob, sizeof (Hob)) == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  DEBUG ((DEBUG_INFO, "SNP:PHY: Auto-negotiation started for PHY 0x%08X at address 0x%02X\r\n",
+          Hob.PhyId, PhyAddr));
+  return EFI_SUCCESS;
+}